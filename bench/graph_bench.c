@@ -0,0 +1,111 @@
+/*
+    gaudiamus
+
+    Graph scheduler benchmark
+
+    Runs synthetic processor graphs of various widths and depths
+    through ga_graph_scheduler, and reports block times and core
+    utilization.
+
+    Usage: ga_graph_bench [workers] [blocks] [work]
+
+      workers   Number of worker threads besides the calling thread
+                (default: one less than the number of CPUs)
+      blocks    Blocks per graph (default 2000)
+      work      Work per node, in multiply-adds per frame (default 16)
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <ga/graph.h>
+#include <ga/alloc.h>
+
+#define FRAMES 64
+
+typedef struct processor {
+    float buffer[FRAMES];
+    unsigned int work;
+} processor;
+
+static void process(void *data, unsigned int frames)
+{
+    processor *p = data;
+    for (unsigned int i = 0; i < frames; i++) {
+        float x = p->buffer[i];
+        for (unsigned int j = 0; j < p->work; j++) {
+            x = x * 0.999f + 0.001f;
+        }
+        p->buffer[i] = x;
+    }
+}
+
+// Layers of width nodes, each reading from (up to) two nodes of the previous layer
+static ga_graph* build_graph(unsigned int width, unsigned int depth, processor *processors)
+{
+    ga_graph *graph = ga_graph_create(width * depth + 1);
+    for (unsigned int d = 0; d < depth; d++) {
+        for (unsigned int w = 0; w < width; w++) {
+            int id = ga_graph_add_node(graph, process, &processors[d * width + w]);
+            if (d > 0) {
+                int prev = (d - 1) * width;
+                ga_graph_connect(graph, prev + w, id);
+                if (width > 1) ga_graph_connect(graph, prev + (w + 1) % width, id);
+            }
+        }
+    }
+    // Final mix node
+    int mix = ga_graph_add_node(graph, process, &processors[width * depth]);
+    for (unsigned int w = 0; w < width; w++) {
+        ga_graph_connect(graph, (depth - 1) * width + w, mix);
+    }
+    ga_graph_compile(graph);
+    return graph;
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int workers = argc > 1 ? atoi(argv[1]) : (cpus > 1 ? cpus - 1 : 0);
+    unsigned int blocks  = argc > 2 ? atoi(argv[2]) : 2000;
+    unsigned int work    = argc > 3 ? atoi(argv[3]) : 16;
+
+    static const unsigned int widths[] = { 1, 4, 16, 64 };
+    static const unsigned int depths[] = { 1, 4, 16 };
+
+    ga_thread_initialize();
+    ga_graph_scheduler *scheduler = ga_graph_scheduler_create(workers, NULL, true);
+
+    printf("%-6s %-6s %-6s %12s %12s %12s\n", "width", "depth", "nodes", "avg us", "max us", "util %");
+    for (int wi = 0; wi < sizeof(widths) / sizeof(widths[0]); wi++) {
+        for (int di = 0; di < sizeof(depths) / sizeof(depths[0]); di++) {
+            unsigned int width = widths[wi], depth = depths[di];
+            unsigned int nodes = width * depth + 1;
+            processor *processors = ga_calloc_aligned(64, nodes, sizeof(processor));
+            for (unsigned int i = 0; i < nodes; i++) processors[i].work = work;
+            ga_graph *graph = build_graph(width, depth, processors);
+
+            // Warm up
+            for (unsigned int b = 0; b < blocks / 10; b++) ga_graph_process(scheduler, graph, FRAMES);
+            ga_graph_reset_stats(scheduler);
+            for (unsigned int b = 0; b < blocks; b++) ga_graph_process(scheduler, graph, FRAMES);
+
+            ga_graph_stats stats;
+            ga_graph_get_stats(scheduler, &stats);
+            uint64_t busy = 0;
+            for (unsigned int i = 0; i < stats.threads; i++) busy += stats.busy_ns[i];
+            printf("%-6u %-6u %-6u %12.2f %12.2f %12.1f\n", width, depth, nodes,
+                   stats.total_ns / 1000.0 / stats.blocks,
+                   stats.max_ns / 1000.0,
+                   100.0 * busy / ((double)stats.total_ns * stats.threads));
+
+            ga_graph_destroy(graph);
+            ga_free(processors);
+        }
+    }
+
+    ga_graph_scheduler_destroy(scheduler);
+    return 0;
+}
@@ -0,0 +1,496 @@
+/*
+    gaudiamus
+
+    Queue and ring buffer benchmark
+
+    Measures the throughput and end to end latency (from push to pop)
+    of ga_spscq, ga_mpmcq, ga_ring_buffer and ga_prioq, across
+    producer/consumer counts, payload sizes, queue capacities and
+    thread pinning configurations.
+
+    Every message carries the time it was pushed; consumers record
+    the time it took to arrive, and the percentiles of those
+    latencies are reported. For ga_prioq, which is not thread safe,
+    the latency is the time of one push plus one pop at a steady
+    size.
+
+    Capacities are in messages, also for ga_ring_buffer.
+
+    Usage: ga_bench [-f table|csv|json] [-n ops] [-q queue] [-p pinning]
+
+      -f    Output format (default: table)
+      -n    Messages per run (default: 200000)
+      -q    Only run one queue: spscq, mpmcq, ring_buffer or prioq
+      -p    Only run one pinning: none, cores or shared
+
+    Pinning:
+      none      No affinity
+      cores     One physical core per thread, sharing a last level cache
+      shared    All threads on the same CPU
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+
+#include <ga/alloc.h>
+#include <ga/thread.h>
+#include <ga/topology.h>
+#include <ga/util/cpu.h>
+#include <ga/queue/spscq.h>
+#include <ga/queue/mpmcq.h>
+#include <ga/queue/prioq.h>
+#include <ga/ring_buffer.h>
+#include <ga/util/time.h>
+
+#define MAX_THREADS     16
+#define SPIN_YIELD      1024        // Failed attempts before yielding the CPU
+
+typedef enum format { FORMAT_TABLE, FORMAT_CSV, FORMAT_JSON } format;
+typedef enum queue_kind { SPSCQ, MPMCQ, RING_BUFFER, PRIOQ, QUEUE_KINDS } queue_kind;
+typedef enum pinning { PIN_NONE, PIN_CORES, PIN_SHARED, PINNINGS } pinning;
+
+static const char *queue_names[] = { "spscq", "mpmcq", "ring_buffer", "prioq" };
+static const char *pinning_names[] = { "none", "cores", "shared" };
+
+typedef struct config {
+    queue_kind      queue;
+    unsigned int    producers, consumers;
+    size_t          payload;
+    size_t          capacity;
+    pinning         pin;
+} config;
+
+typedef struct result {
+    double          seconds;
+    uint64_t        ops;
+    uint64_t        p50, p90, p99, p999, max;
+} result;
+
+typedef struct message {
+    uint64_t        stamp;
+    uint8_t         payload[];
+} message;
+
+typedef struct bench bench;
+
+typedef struct worker {
+    bench           *bench;
+    unsigned int    index;
+    uint8_t         *pool;          // Producer: messages to send, reused round robin
+    size_t          pool_count;
+    uint32_t        *latencies;     // Consumer: one per received message
+    uint64_t        received;
+    uint64_t        checksum;
+} worker;
+
+struct bench {
+    config          cfg;
+    uint64_t        ops;            // Messages per producer
+    size_t          message_size;
+    void            *queue;
+    atomic_uint     ready;
+    atomic_uint     go;
+    message         *stop;          // Sent to each consumer when producers are done
+    worker          producers[MAX_THREADS];
+    worker          consumers[MAX_THREADS];
+};
+
+// -----------------------------------------------------------------------------
+
+static inline void backoff(unsigned int *spins)
+{
+    if (++*spins % SPIN_YIELD == 0) {
+        sched_yield();
+    } else {
+        ga_cpu_relax();
+    }
+}
+
+static void wait_for_start(bench *b)
+{
+    atomic_fetch_add(&b->ready, 1);
+    unsigned int spins = 0;
+    while (!atomic_load_explicit(&b->go, memory_order_acquire)) backoff(&spins);
+}
+
+static bool try_push(bench *b, message *msg)
+{
+    switch (b->cfg.queue) {
+    case SPSCQ:
+        return ga_spscq_push(b->queue, msg);
+    case MPMCQ:
+        return ga_mpmcq_push(b->queue, msg);
+    case RING_BUFFER:
+        return ga_ring_buffer_write_atomic(b->queue, b->message_size, msg) == b->message_size;
+    default:
+        return false;
+    }
+}
+
+static message* try_pop(bench *b, message *buffer)
+{
+    switch (b->cfg.queue) {
+    case SPSCQ:
+        return ga_spscq_pop(b->queue);
+    case MPMCQ:
+        return ga_mpmcq_pop(b->queue);
+    case RING_BUFFER:
+        return ga_ring_buffer_read_atomic(b->queue, b->message_size, buffer) == b->message_size ? buffer : NULL;
+    default:
+        return NULL;
+    }
+}
+
+static void* producer_thread(void *data)
+{
+    worker *w = data;
+    bench *b = w->bench;
+    wait_for_start(b);
+
+    for (uint64_t i = 0; i < b->ops; i++) {
+        message *msg = (message*)(w->pool + (i % w->pool_count) * b->message_size);
+        memset(msg->payload, (uint8_t)i, b->cfg.payload);
+        msg->stamp = ga_now_ns();
+        unsigned int spins = 0;
+        while (!try_push(b, msg)) backoff(&spins);
+    }
+    return NULL;
+}
+
+static void* consumer_thread(void *data)
+{
+    worker *w = data;
+    bench *b = w->bench;
+    message *buffer = ga_malloc_aligned(64, b->message_size);
+    wait_for_start(b);
+
+    for (;;) {
+        message *msg;
+        unsigned int spins = 0;
+        while (!(msg = try_pop(b, buffer))) backoff(&spins);
+        uint64_t latency = ga_now_ns() - msg->stamp;
+        if (msg->stamp == UINT64_MAX) break;
+
+        // Touch the payload, as a real consumer would
+        for (size_t i = 0; i < b->cfg.payload; i += 64) w->checksum += msg->payload[i];
+        w->latencies[w->received++] = latency > UINT32_MAX ? UINT32_MAX : latency;
+    }
+    ga_free(buffer);
+    return NULL;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void percentiles(uint32_t *values, uint64_t count, result *res)
+{
+    qsort(values, count, sizeof(uint32_t), compare_u32);
+    res->p50  = count ? values[count * 50 / 100] : 0;
+    res->p90  = count ? values[count * 90 / 100] : 0;
+    res->p99  = count ? values[count * 99 / 100] : 0;
+    res->p999 = count ? values[count * 999 / 1000] : 0;
+    res->max  = count ? values[count - 1] : 0;
+}
+
+// -----------------------------------------------------------------------------
+
+static void run_threaded(const config *cfg, uint64_t ops, ga_topology *topology, result *res)
+{
+    bench *b = ga_newc_aligned(bench);
+    b->cfg = *cfg;
+    b->ops = ops / cfg->producers;
+    b->message_size = (sizeof(message) + cfg->payload + 7) & ~(size_t)7;
+    // The stop message has a timestamp that can't be confused with a real one
+    b->stop = ga_calloc_aligned(64, 1, b->message_size);
+    b->stop->stamp = UINT64_MAX;
+
+    switch (cfg->queue) {
+    case SPSCQ:
+        b->queue = ga_spscq_create(cfg->capacity, SPSCQ_OVERFLOW_DISCARD);
+        break;
+    case MPMCQ:
+        b->queue = ga_mpmcq_create(cfg->capacity);
+        break;
+    case RING_BUFFER:
+        b->queue = ga_ring_buffer_create(cfg->capacity * b->message_size);
+        break;
+    default:
+        break;
+    }
+
+    unsigned int threads = cfg->producers + cfg->consumers;
+    ga_cpu_set sets[MAX_THREADS * 2];
+    if (cfg->pin == PIN_CORES) {
+        ga_topology_place(topology, GA_PLACEMENT_CORES_SAME_LLC, threads, sets);
+    } else {
+        ga_topology_place(topology, GA_PLACEMENT_ANY, threads, sets);
+        if (cfg->pin == PIN_SHARED) {
+            for (unsigned int i = 0; i < threads; i++) {
+                ga_cpu_set_add(&sets[i], ga_topology_cpu(topology, 0)->cpu);
+            }
+        }
+    }
+
+    // Messages in flight are bounded by the capacity, plus one being read by each consumer
+    size_t pool_count = cfg->capacity + cfg->consumers + 1;
+    ga_thread *handles[MAX_THREADS * 2];
+    ga_thread_attr attr = GA_THREAD_ATTR_DEFAULT;     // Unnamed, so thread creation isn't logged
+
+    for (unsigned int i = 0; i < cfg->consumers; i++) {
+        worker *w = &b->consumers[i];
+        w->bench = b;
+        w->index = i;
+        w->latencies = ga_malloc((b->ops * cfg->producers + 1) * sizeof(uint32_t));
+        attr.affinity = sets[i];
+        handles[i] = ga_thread_create_with_attr(consumer_thread, w, &attr);
+    }
+    for (unsigned int i = 0; i < cfg->producers; i++) {
+        worker *w = &b->producers[i];
+        w->bench = b;
+        w->index = i;
+        w->pool_count = pool_count;
+        w->pool = ga_calloc_aligned(64, pool_count, b->message_size);
+        attr.affinity = sets[cfg->consumers + i];
+        handles[cfg->consumers + i] = ga_thread_create_with_attr(producer_thread, w, &attr);
+    }
+
+    while (atomic_load(&b->ready) < threads) sched_yield();
+    uint64_t start = ga_now_ns();
+    atomic_store_explicit(&b->go, 1, memory_order_release);
+
+    for (unsigned int i = 0; i < cfg->producers; i++) {
+        ga_thread_join(handles[cfg->consumers + i]);
+    }
+    for (unsigned int i = 0; i < cfg->consumers; i++) {
+        unsigned int spins = 0;
+        while (!try_push(b, b->stop)) backoff(&spins);
+    }
+    for (unsigned int i = 0; i < cfg->consumers; i++) {
+        ga_thread_join(handles[i]);
+    }
+    uint64_t end = ga_now_ns();
+
+    // Gather the latencies of all consumers
+    uint64_t received = 0;
+    for (unsigned int i = 0; i < cfg->consumers; i++) received += b->consumers[i].received;
+    uint32_t *latencies = ga_malloc((received + 1) * sizeof(uint32_t));
+    uint64_t offset = 0;
+    for (unsigned int i = 0; i < cfg->consumers; i++) {
+        worker *w = &b->consumers[i];
+        memcpy(latencies + offset, w->latencies, w->received * sizeof(uint32_t));
+        offset += w->received;
+        ga_free(w->latencies);
+    }
+    for (unsigned int i = 0; i < cfg->producers; i++) {
+        ga_free(b->producers[i].pool);
+    }
+
+    res->seconds = (end - start) / 1e9;
+    res->ops = received;
+    percentiles(latencies, received, res);
+    ga_free(latencies);
+
+    switch (cfg->queue) {
+    case SPSCQ:
+        ga_spscq_destroy(b->queue);
+        break;
+    case MPMCQ:
+        ga_mpmcq_destroy(b->queue);
+        break;
+    case RING_BUFFER:
+        ga_ring_buffer_destroy(b->queue);
+        break;
+    default:
+        break;
+    }
+    ga_free(b->stop);
+    ga_free(b);
+}
+
+static int compare_keys(void *a, void *b)
+{
+    uint64_t x = *(uint64_t*)a, y = *(uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Push and pop pairs on a queue holding `capacity` items
+static void run_prioq(const config *cfg, uint64_t ops, result *res)
+{
+    ga_prioq *queue = ga_prioq_create(compare_keys);
+    size_t count = cfg->capacity + 1;
+    uint64_t *keys = ga_malloc(count * sizeof(uint64_t));
+    uint32_t *latencies = ga_malloc(ops * sizeof(uint32_t));
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+    ga_prioq_preallocate(queue, count);
+    for (size_t i = 0; i < cfg->capacity; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        keys[i] = seed >> 16;
+        ga_prioq_push(queue, &keys[i]);
+    }
+    uint64_t *spare = &keys[cfg->capacity];
+    uint64_t last = 0;
+
+    uint64_t start = ga_now_ns();
+    for (uint64_t i = 0; i < ops; i++) {
+        // New keys come after the last popped one, like scheduled events
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        *spare = last + (seed >> 40);
+        uint64_t t0 = ga_now_ns();
+        ga_prioq_push(queue, spare);
+        spare = ga_prioq_pop(queue);
+        latencies[i] = ga_now_ns() - t0;
+        last = *spare;
+    }
+    uint64_t end = ga_now_ns();
+
+    res->seconds = (end - start) / 1e9;
+    res->ops = ops;
+    percentiles(latencies, ops, res);
+
+    ga_free(latencies);
+    ga_free(keys);
+    ga_prioq_destroy(queue);
+}
+
+// -----------------------------------------------------------------------------
+
+static void print_header(format fmt)
+{
+    switch (fmt) {
+    case FORMAT_TABLE:
+        printf("%-12s %4s %4s %8s %8s %-7s %12s %9s %9s %9s %9s %10s\n",
+               "queue", "prod", "cons", "payload", "capacity", "pinning",
+               "Mops/s", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+        break;
+    case FORMAT_CSV:
+        printf("queue,producers,consumers,payload,capacity,pinning,ops,seconds,mops,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+        break;
+    case FORMAT_JSON:
+        printf("[\n");
+        break;
+    }
+}
+
+static void print_result(format fmt, const config *cfg, const result *res, bool first)
+{
+    double mops = res->ops / res->seconds / 1e6;
+    switch (fmt) {
+    case FORMAT_TABLE:
+        printf("%-12s %4u %4u %8zu %8zu %-7s %12.3f %9llu %9llu %9llu %9llu %10llu\n",
+               queue_names[cfg->queue], cfg->producers, cfg->consumers, cfg->payload, cfg->capacity,
+               pinning_names[cfg->pin], mops,
+               (unsigned long long)res->p50, (unsigned long long)res->p90, (unsigned long long)res->p99,
+               (unsigned long long)res->p999, (unsigned long long)res->max);
+        break;
+    case FORMAT_CSV:
+        printf("%s,%u,%u,%zu,%zu,%s,%llu,%.6f,%.3f,%llu,%llu,%llu,%llu,%llu\n",
+               queue_names[cfg->queue], cfg->producers, cfg->consumers, cfg->payload, cfg->capacity,
+               pinning_names[cfg->pin], (unsigned long long)res->ops, res->seconds, mops,
+               (unsigned long long)res->p50, (unsigned long long)res->p90, (unsigned long long)res->p99,
+               (unsigned long long)res->p999, (unsigned long long)res->max);
+        break;
+    case FORMAT_JSON:
+        printf("%s  {\"queue\": \"%s\", \"producers\": %u, \"consumers\": %u, \"payload\": %zu, "
+               "\"capacity\": %zu, \"pinning\": \"%s\", \"ops\": %llu, \"seconds\": %.6f, \"mops\": %.3f, "
+               "\"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+               first ? "" : ",\n",
+               queue_names[cfg->queue], cfg->producers, cfg->consumers, cfg->payload, cfg->capacity,
+               pinning_names[cfg->pin], (unsigned long long)res->ops, res->seconds, mops,
+               (unsigned long long)res->p50, (unsigned long long)res->p90, (unsigned long long)res->p99,
+               (unsigned long long)res->p999, (unsigned long long)res->max);
+        break;
+    }
+    fflush(stdout);
+}
+
+static void print_footer(format fmt)
+{
+    if (fmt == FORMAT_JSON) printf("\n]\n");
+}
+
+static int find_name(const char **names, int count, const char *name)
+{
+    for (int i = 0; i < count; i++) {
+        if (!strcmp(names[i], name)) return i;
+    }
+    fprintf(stderr, "Unknown name: %s\n", name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    format fmt = FORMAT_TABLE;
+    uint64_t ops = 200000;
+    int only_queue = -1, only_pinning = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:n:q:p:")) != -1) {
+        switch (opt) {
+        case 'f':
+            fmt = !strcmp(optarg, "csv") ? FORMAT_CSV : !strcmp(optarg, "json") ? FORMAT_JSON : FORMAT_TABLE;
+            break;
+        case 'n':
+            ops = strtoull(optarg, NULL, 10);
+            break;
+        case 'q':
+            only_queue = find_name(queue_names, QUEUE_KINDS, optarg);
+            break;
+        case 'p':
+            only_pinning = find_name(pinning_names, PINNINGS, optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-f table|csv|json] [-n ops] [-q queue] [-p pinning]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    static const size_t payloads[] = { 8, 64, 512 };
+    static const size_t capacities[] = { 64, 1024, 16384 };
+    static const unsigned int mpmc_threads[][2] = { { 1, 1 }, { 2, 2 }, { 4, 4 }, { 4, 1 }, { 1, 4 } };
+
+    ga_thread_initialize();
+    ga_topology *topology = ga_topology_create();
+    print_header(fmt);
+    bool first = true;
+
+    for (int q = 0; q < QUEUE_KINDS; q++) {
+        if (only_queue >= 0 && q != only_queue) continue;
+        for (int p = 0; p < PINNINGS; p++) {
+            if (only_pinning >= 0 && p != only_pinning) continue;
+            if (q == PRIOQ && p != PIN_NONE) continue;
+            for (int c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+                for (int s = 0; s < sizeof(payloads) / sizeof(payloads[0]); s++) {
+                    if (q == PRIOQ && s > 0) continue;
+                    int thread_configs = q == MPMCQ ? sizeof(mpmc_threads) / sizeof(mpmc_threads[0]) : 1;
+                    for (int t = 0; t < thread_configs; t++) {
+                        config cfg = { q, mpmc_threads[t][0], mpmc_threads[t][1], payloads[s], capacities[c], p };
+                        result res;
+                        if (q == PRIOQ) {
+                            cfg.producers = cfg.consumers = 0;
+                            run_prioq(&cfg, ops, &res);
+                        } else {
+                            run_threaded(&cfg, ops, topology, &res);
+                        }
+                        print_result(fmt, &cfg, &res, first);
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+
+    print_footer(fmt);
+    ga_topology_destroy(topology);
+    return 0;
+}
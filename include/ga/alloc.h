@@ -1,16 +1,121 @@
 #ifndef _GA_ALLOC
 #define _GA_ALLOC
 
+/*****************************************************************
+
+                    MEMORY ALLOCATION
+
+  Thin wrappers around malloc and friends, which keep allocation
+  statistics. Every block is preceded by a small header holding
+  its size and tag, so the statistics are correct in both debug
+  and release builds.
+
+  The statistics are kept in per-thread shards, which are only
+  written by their owning thread (no atomic read-modify-write and
+  no shared cache lines on the allocation path), and summed up
+  when read with ga_alloc_get_stats. Each shard keeps its own
+  high-water marks, updated on every allocation, and the peaks
+  reported are their sum. That never misses a short spike, but
+  may exceed the true peak when threads peak at different times
+  or free each other's blocks. The shard of an exited thread is
+  taken over, counts included, by the next thread that allocates,
+  so short-lived threads don't add up.
+
+  Allocations can be tagged with the subsystem that made them
+  (see ga_alloc_tag), to see where the memory goes. Untagged
+  allocations get GA_ALLOC_TAG_DEFAULT.
+
+  Memory that is used from realtime threads can be allocated with
+  ga_malloc_realtime/ga_calloc_realtime, which give the block pages
+  of its own, and depending on the flags prefault them, mlock them
+  and ask for transparent huge pages (where available). Passing
+  GA_MEM_REALTIME uses the global flags set with
+  ga_alloc_set_realtime_flags (by default GA_MEM_PREFAULT |
+  GA_MEM_LOCK).
+
+  If mlock is not permitted, the memory is still prefaulted, a
+  warning is logged once, and ga_alloc_lock_error returns the
+  reason. ga_alloc_is_locked tells whether a block actually got
+  locked. Realtime blocks are freed with ga_free.
+
+ *****************************************************************/
+
 #include <stdlib.h>
+#include <ga/util.h>
+#include "config.h"
+
+/*
+ *  TYPES
+ */
+
+typedef enum ga_alloc_tag {
+    GA_ALLOC_TAG_DEFAULT = 0,
+    GA_ALLOC_TAG_QUEUE,
+    GA_ALLOC_TAG_RING_BUFFER,
+    GA_ALLOC_TAG_THREAD,
+    GA_ALLOC_TAG_STRING,
+    GA_ALLOC_TAG_COUNT
+} ga_alloc_tag;
+
+typedef enum ga_mem_flags {
+    GA_MEM_DEFAULT      = 0,
+    GA_MEM_PREFAULT     = 1 << 0,   // Touch all pages up front
+    GA_MEM_LOCK         = 1 << 1,   // mlock the pages (implies GA_MEM_PREFAULT)
+    GA_MEM_HUGE_PAGES   = 1 << 2,   // Use transparent huge pages for big blocks, where available
+    GA_MEM_REALTIME     = 1 << 3    // Use the global realtime flags
+} ga_mem_flags;
+
+// Size class i counts allocations of 2^(i-1) to 2^i - 1 bytes
+#define GA_ALLOC_SIZE_CLASSES 32
+
+typedef struct ga_alloc_stats {
+    size_t bytes_current;
+    size_t bytes_peak;
+    size_t bytes_total;
+    size_t regions_current;
+    size_t regions_peak;
+    size_t regions_total;
+    size_t tag_bytes[GA_ALLOC_TAG_COUNT];               // Currently allocated bytes per tag
+    size_t tag_regions[GA_ALLOC_TAG_COUNT];             // Currently allocated regions per tag
+    size_t size_classes[GA_ALLOC_SIZE_CLASSES];         // Number of allocations per size class (total)
+} ga_alloc_stats;
+
+/*
+ *  FUNCTIONS
+ */
 
 void* ga_malloc(size_t size);
 void* ga_calloc(size_t count, size_t size);
 void* ga_realloc(void *ptr, size_t size);
 void ga_free(void *ptr);
 
+// Aligned allocation. The alignment must be a power of two, and the
+// returned block is aligned to it in both debug and release builds.
+// Aligned blocks are freed with ga_free, but cannot be passed to ga_realloc.
+void* ga_malloc_aligned(size_t alignment, size_t size);
+void* ga_calloc_aligned(size_t alignment, size_t count, size_t size);
+
+void* ga_malloc_tagged(size_t size, ga_alloc_tag tag);
+void* ga_calloc_tagged(size_t count, size_t size, ga_alloc_tag tag);
+void* ga_malloc_aligned_tagged(size_t alignment, size_t size, ga_alloc_tag tag);
+void* ga_calloc_aligned_tagged(size_t alignment, size_t count, size_t size, ga_alloc_tag tag);
+
+void* ga_malloc_realtime(size_t size, ga_mem_flags flags, ga_alloc_tag tag);
+void* ga_calloc_realtime(size_t count, size_t size, ga_mem_flags flags, ga_alloc_tag tag);
+void ga_alloc_set_realtime_flags(ga_mem_flags flags);
+ga_mem_flags ga_alloc_get_realtime_flags();
+bool ga_alloc_is_locked(void *ptr);
+const char* ga_alloc_lock_error();
+
+void ga_alloc_get_stats(ga_alloc_stats *stats);
+const char* ga_alloc_tag_name(ga_alloc_tag tag);
 void ga_print_alloc_info();
 
 #define ga_new(type) ga_malloc(sizeof(type))
 #define ga_newc(type) ga_calloc(sizeof(type), 1)
 
+// Cacheline aligned variants, for structs that are shared between threads
+#define ga_new_aligned(type) ga_malloc_aligned(CACHELINE_SIZE, sizeof(type))
+#define ga_newc_aligned(type) ga_calloc_aligned(CACHELINE_SIZE, sizeof(type), 1)
+
 #endif
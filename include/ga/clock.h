@@ -0,0 +1,98 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+
+#ifndef _GA_CLOCK
+#define _GA_CLOCK
+
+/*****************************************************************
+
+                        PERIODIC CLOCK
+
+  Stands in for an audio device: a realtime thread calling a
+  callback every `frames` frames at `sample_rate`, for testing and
+  load testing the engine without sound hardware.
+
+  Deadlines are absolute (clock_nanosleep with TIMER_ABSTIME on
+  Linux) and computed from the frame count, so the clock doesn't
+  drift. The callback runs inside ga_realtime_enter/exit.
+
+  If a callback finishes after the next deadline, a miss is
+  counted and the clock restarts from the current time, like a
+  device skipping after an xrun.
+
+  In freewheel mode the callback is called again as soon as it
+  returns, to run the engine as fast as possible (e.g. for offline
+  rendering or to measure throughput).
+
+  ga_clock_set_histogram installs a ga_histogram receiving every
+  callback duration (in ns), for percentiles.
+
+  If attr is NULL, the thread runs with SCHED_FIFO and a
+  prefaulted stack, or with the default scheduling when the process
+  isn't allowed to use realtime scheduling.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <ga/util.h>
+#include <ga/thread.h>
+#include <ga/histogram.h>
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_clock ga_clock;
+
+typedef void (* ga_clock_callback)(void *data, uint64_t frame, unsigned int frames);
+
+#define GA_CLOCK_DEFAULT_PRIORITY   80
+
+typedef struct ga_clock_stats {
+    uint64_t cycles;
+    uint64_t misses;                //  Callbacks finishing after the next deadline
+    uint64_t frames;                //  Frames processed
+    uint64_t period_ns;
+    uint64_t total_ns;              //  Sum of callback durations
+    uint64_t max_ns;                //  Longest callback
+    uint64_t max_late_ns;           //  Latest wakeup after a deadline
+} ga_clock_stats;
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_clock* ga_clock_create(unsigned int sample_rate, unsigned int frames, ga_clock_callback callback, void *data, const ga_thread_attr *attr);
+void ga_clock_destroy(ga_clock *clock);
+
+void ga_clock_set_freewheel(ga_clock *clock, bool freewheel);
+bool ga_clock_is_freewheeling(ga_clock *clock);
+
+void ga_clock_get_stats(ga_clock *clock, ga_clock_stats *stats);
+void ga_clock_reset_stats(ga_clock *clock);
+void ga_clock_set_histogram(ga_clock *clock, ga_histogram *histogram);
+
+#endif
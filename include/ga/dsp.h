@@ -0,0 +1,194 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+#ifndef _GA_DSP
+#define _GA_DSP
+
+/*****************************************************************
+                          DSP KERNELS
+
+  Vectorized kernels for the inner loops of mixing and metering,
+  operating on buffers of n floats:
+
+    ga_dsp_clear        dst = 0
+    ga_dsp_copy         dst = src
+    ga_dsp_add          dst += src
+    ga_dsp_mix          dst += src * gain
+    ga_dsp_mix_ramp     dst += src * gain, ramping linearly
+    ga_dsp_gain_ramp    dst *= gain, ramping linearly
+    ga_dsp_pan          left += src * left_gain, right += src * right_gain
+    ga_dsp_peak         max |src|
+    ga_dsp_rms          sqrt(mean(src * src))
+    ga_dsp_clip         dst = clamp(dst, -limit, limit)
+    ga_dsp_dot          sum(a * b), e.g. for FIR filters
+
+  A ramp from start to end applies start + (end - start) * i / n to
+  sample i, so it reaches end at the first sample of the next
+  buffer. ga_dsp_pan_gains computes equal power gains for a pan
+  position between -1 (left) and 1 (right).
+
+  Each kernel has a scalar reference version and, on x86, SSE2,
+  AVX2 and AVX-512 versions. The best set the CPU supports (as
+  reported by CPUID) is selected once when the library is loaded.
+  ga_dsp_set_isa selects another set, e.g. to compare them; it is
+  not meant to be called while kernels are running.
+
+  Destination and source buffers may be the same, but must not
+  otherwise overlap. The kernels accept any alignment, but buffers
+  aligned to GA_DSP_ALIGNMENT never split a vector load across
+  cache lines. ga_dsp_alloc allocates such a buffer (zeroed); free
+  it with ga_free. Memory from ga_malloc_realtime (with
+  prefaulting or locking) is page aligned, so it qualifies too.
+
+  Results match the scalar versions to within rounding: a vector
+  multiply-add may be fused (AVX-512 implies FMA), and ga_dsp_rms
+  and ga_dsp_dot sum in a different order. Clearing, copying,
+  adding, peaks and clipping are exact; clipping leaves NaN as it
+  is, like the scalar version.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+#include <ga/util.h>
+#include "config.h"
+
+#define GA_DSP_ALIGNMENT    64
+
+/*
+ *  TYPES
+ */
+
+typedef enum {
+    GA_DSP_SCALAR,
+    GA_DSP_SSE2,
+    GA_DSP_AVX2,
+    GA_DSP_AVX512,
+    GA_DSP_ISA_COUNT
+} ga_dsp_isa;
+
+/*
+ *  FUNCTIONS
+ */
+
+float* ga_dsp_alloc(size_t n);
+
+ga_dsp_isa ga_dsp_get_isa();
+ga_dsp_isa ga_dsp_best_isa();
+bool ga_dsp_set_isa(ga_dsp_isa isa);
+const char* ga_dsp_isa_name(ga_dsp_isa isa);
+
+static inline void ga_dsp_clear(float *dst, size_t n);
+static inline void ga_dsp_copy(float *dst, const float *src, size_t n);
+static inline void ga_dsp_add(float *dst, const float *src, size_t n);
+static inline void ga_dsp_mix(float *dst, const float *src, size_t n, float gain);
+static inline void ga_dsp_mix_ramp(float *dst, const float *src, size_t n, float start, float end);
+static inline void ga_dsp_gain_ramp(float *dst, size_t n, float start, float end);
+static inline void ga_dsp_pan(float *left, float *right, const float *src, size_t n, float left_gain, float right_gain);
+static inline float ga_dsp_peak(const float *src, size_t n);
+static inline float ga_dsp_rms(const float *src, size_t n);
+static inline void ga_dsp_clip(float *dst, size_t n, float limit);
+static inline float ga_dsp_dot(const float *a, const float *b, size_t n);
+void ga_dsp_pan_gains(float pan, float *left_gain, float *right_gain);
+
+// "Private" stuff below
+// (Must be present in the header file to enable inlining)
+
+typedef struct ga_dsp_kernels {
+    void (*clear)(float *dst, size_t n);
+    void (*copy)(float *dst, const float *src, size_t n);
+    void (*add)(float *dst, const float *src, size_t n);
+    void (*mix_ramp)(float *dst, const float *src, size_t n, float start, float step);
+    void (*gain_ramp)(float *dst, size_t n, float start, float step);
+    void (*pan)(float *left, float *right, const float *src, size_t n, float left_gain, float right_gain);
+    float (*peak)(const float *src, size_t n);
+    float (*sum_squares)(const float *src, size_t n);
+    void (*clip)(float *dst, size_t n, float limit);
+    float (*dot)(const float *a, const float *b, size_t n);
+} ga_dsp_kernels;
+
+extern ga_dsp_kernels ga_dsp_current;
+extern const ga_dsp_kernels ga_dsp_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+extern const ga_dsp_kernels ga_dsp_sse2;
+extern const ga_dsp_kernels ga_dsp_avx2;
+extern const ga_dsp_kernels ga_dsp_avx512;
+#endif
+
+static inline void ga_dsp_clear(float *dst, size_t n)
+{
+    ga_dsp_current.clear(dst, n);
+}
+
+static inline void ga_dsp_copy(float *dst, const float *src, size_t n)
+{
+    ga_dsp_current.copy(dst, src, n);
+}
+
+static inline void ga_dsp_add(float *dst, const float *src, size_t n)
+{
+    ga_dsp_current.add(dst, src, n);
+}
+
+static inline void ga_dsp_mix(float *dst, const float *src, size_t n, float gain)
+{
+    ga_dsp_current.mix_ramp(dst, src, n, gain, 0.0f);
+}
+
+static inline void ga_dsp_mix_ramp(float *dst, const float *src, size_t n, float start, float end)
+{
+    if (n) ga_dsp_current.mix_ramp(dst, src, n, start, (end - start) / n);
+}
+
+static inline void ga_dsp_gain_ramp(float *dst, size_t n, float start, float end)
+{
+    if (n) ga_dsp_current.gain_ramp(dst, n, start, (end - start) / n);
+}
+
+static inline void ga_dsp_pan(float *left, float *right, const float *src, size_t n, float left_gain, float right_gain)
+{
+    ga_dsp_current.pan(left, right, src, n, left_gain, right_gain);
+}
+
+static inline float ga_dsp_peak(const float *src, size_t n)
+{
+    return ga_dsp_current.peak(src, n);
+}
+
+static inline float ga_dsp_rms(const float *src, size_t n)
+{
+    return n ? sqrtf(ga_dsp_current.sum_squares(src, n) / n) : 0.0f;
+}
+
+static inline void ga_dsp_clip(float *dst, size_t n, float limit)
+{
+    ga_dsp_current.clip(dst, n, limit);
+}
+
+static inline float ga_dsp_dot(const float *a, const float *b, size_t n)
+{
+    return ga_dsp_current.dot(a, b, n);
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+#ifndef _GA_EBR
+#define _GA_EBR
+
+/*****************************************************************
+
+                EPOCH BASED MEMORY RECLAMATION
+
+  Makes it safe to free objects that other threads (e.g. the
+  audio thread) may still be reading.
+
+  Reader threads register once (ga_ebr_register, which allocates),
+  and then wrap every access to shared objects in
+  ga_ebr_enter/ga_ebr_exit. Enter and exit are wait-free: a store
+  and a fence on enter, a store on exit. They don't nest.
+
+  A writer that has unlinked an object (so that no new reader can
+  find it) hands it to ga_ebr_retire, with an optional destructor
+  (ga_free is used if NULL). A background thread advances the global
+  epoch when all readers inside a critical section have seen the
+  current one, and frees retired objects once the epoch has advanced
+  twice since they were retired - by then every reader that could
+  have seen the object has left its critical section.
+
+  ga_ebr_retire allocates, and should not be called from a
+  realtime section.
+
+  ga_ebr_collect runs one reclamation pass on the calling thread.
+  ga_ebr_destroy stops the background thread and frees everything
+  still retired; no reader may be inside a critical section then.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <ga/util.h>
+#include "config.h"
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_ebr ga_ebr;
+typedef struct ga_ebr_reader ga_ebr_reader;
+
+typedef void (* ga_ebr_destructor)(void*);
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_ebr* ga_ebr_create(unsigned int interval_ms);
+void ga_ebr_destroy(ga_ebr *ebr);
+
+ga_ebr_reader* ga_ebr_register(ga_ebr *ebr);
+void ga_ebr_unregister(ga_ebr_reader *reader);
+
+static inline void ga_ebr_enter(ga_ebr_reader *reader);
+static inline void ga_ebr_exit(ga_ebr_reader *reader);
+
+void ga_ebr_retire(ga_ebr *ebr, void *ptr, ga_ebr_destructor destructor);
+void ga_ebr_collect(ga_ebr *ebr);
+size_t ga_ebr_pending(ga_ebr *ebr);
+
+// "Private" stuff below
+// (Must be present in the header file to enable inlining)
+
+struct ga_ebr_reader
+{
+    atomic_size_t state;            // (epoch << 1) | 1 when inside a critical section, 0 otherwise
+    atomic_size_t *global_epoch;
+    atomic_uint used;
+    ga_ebr_reader *next;
+    char pad[CACHELINE_SIZE - (sizeof(atomic_size_t) + sizeof(atomic_size_t*) + sizeof(atomic_uint) + sizeof(ga_ebr_reader*))];
+};
+
+static inline void ga_ebr_enter(ga_ebr_reader *reader)
+{
+    assert(!atomic_load_explicit(&reader->state, memory_order_relaxed) && "ga_ebr_enter doesn't nest");
+    size_t epoch = atomic_load_explicit(reader->global_epoch, memory_order_relaxed);
+    atomic_store_explicit(&reader->state, (epoch << 1) | 1, memory_order_relaxed);
+    // The announcement must be visible before any shared object is read
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+static inline void ga_ebr_exit(ga_ebr_reader *reader)
+{
+    atomic_store_explicit(&reader->state, 0, memory_order_release);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef _GA_EVENTCOUNT
+#define _GA_EVENTCOUNT
+
+/*****************************************************************
+
+                        EVENTCOUNT
+
+  Lets threads sleep until "something happened", without a lock
+  and without the notifier paying for a system call unless
+  someone is actually sleeping. Typical use by a waiter:
+
+    for (;;) {
+        if (try_get_work()) break;
+        unsigned int key = ga_eventcount_prepare(&ec);
+        if (try_get_work()) {
+            ga_eventcount_cancel(&ec);
+            break;
+        }
+        ga_eventcount_wait(&ec, key);
+    }
+
+  and by a notifier, after publishing work:
+
+    ga_eventcount_notify(&ec);
+
+  ga_eventcount_notify is a fence and a load when nobody waits.
+  It wakes all sleeping waiters; ga_eventcount_notify_one wakes
+  only one, for work that one waiter can take care of (waiters
+  that have prepared but not yet slept still return).
+
+ *****************************************************************/
+
+#include <stdatomic.h>
+#include <ga/futex.h>
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_eventcount {
+    atomic_uint epoch;
+    atomic_uint waiters;
+} ga_eventcount;
+
+#define GA_EVENTCOUNT_INIT { 0, 0 }
+
+/*
+ *  FUNCTIONS
+ */
+
+static inline unsigned int ga_eventcount_prepare(ga_eventcount *ec)
+{
+    atomic_fetch_add_explicit(&ec->waiters, 1, memory_order_seq_cst);
+    return atomic_load_explicit(&ec->epoch, memory_order_seq_cst);
+}
+
+static inline void ga_eventcount_cancel(ga_eventcount *ec)
+{
+    atomic_fetch_sub_explicit(&ec->waiters, 1, memory_order_relaxed);
+}
+
+static inline void ga_eventcount_wait(ga_eventcount *ec, unsigned int key)
+{
+    if (atomic_load_explicit(&ec->epoch, memory_order_seq_cst) == key) {
+        ga_futex_wait(&ec->epoch, key, GA_FUTEX_FOREVER);
+    }
+    atomic_fetch_sub_explicit(&ec->waiters, 1, memory_order_relaxed);
+}
+
+static inline void ga_eventcount_notify(ga_eventcount *ec)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ec->waiters, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&ec->epoch, 1, memory_order_seq_cst);
+        ga_futex_wake_all(&ec->epoch);
+    }
+}
+
+static inline void ga_eventcount_notify_one(ga_eventcount *ec)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ec->waiters, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&ec->epoch, 1, memory_order_seq_cst);
+        ga_futex_wake(&ec->epoch, 1);
+    }
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _GA_FUTEX
+#define _GA_FUTEX
+
+/*****************************************************************
+
+                    FUTEX WRAPPER
+
+  ga_futex_wait sleeps while *address == expected, until woken by
+  ga_futex_wake, or timeout_ns has passed. Spurious wakeups are
+  possible, so callers must recheck their condition.
+
+  Uses futexes on Linux. Elsewhere, ga_futex_wait polls with short
+  sleeps and ga_futex_wake does nothing.
+
+ *****************************************************************/
+
+#include <stdatomic.h>
+
+#define GA_FUTEX_FOREVER (~0ull)
+
+void ga_futex_wait(atomic_uint *address, unsigned int expected, unsigned long long timeout_ns);
+void ga_futex_wake(atomic_uint *address, int count);
+void ga_futex_wake_all(atomic_uint *address);
+
+#endif
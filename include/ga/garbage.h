@@ -0,0 +1,85 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+
+#ifndef _GA_GARBAGE
+#define _GA_GARBAGE
+
+/*****************************************************************
+
+                    DEFERRED FREE SERVICE
+
+  Lets a realtime thread get rid of memory without calling the
+  allocator. The realtime thread pushes pointers (with an optional
+  destructor, ga_free is used if NULL) into a preallocated SPSC
+  channel, and a low priority background thread drains the
+  channel and frees them in batches. The background thread is
+  created with GA_THREAD_POLICY_IDLE, so it only runs when no
+  other thread wants the CPU; if the CPU stays busy, the backlog
+  grows until pushes overflow.
+
+  There must be a single pushing thread per ga_garbage (create
+  one per realtime thread). Pushing never blocks and never
+  allocates. If the channel is full, ga_garbage_push returns false
+  and counts an overflow; the caller still owns the pointer then.
+
+  ga_garbage_get_stats returns the current backlog, the highest
+  backlog seen, the number of overflows and the number of freed
+  objects.
+
+  ga_garbage_destroy stops the background thread, and frees
+  everything still in the channel.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <ga/util.h>
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_garbage ga_garbage;
+
+typedef void (* ga_garbage_destructor)(void*);
+
+typedef struct ga_garbage_stats {
+    size_t backlog;                 // Objects waiting to be freed
+    size_t max_backlog;             // Highest backlog seen by the pushing thread
+    size_t overflows;               // Pushes that failed because the channel was full
+    size_t freed;                   // Objects freed so far
+} ga_garbage_stats;
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_garbage* ga_garbage_create(size_t capacity, unsigned int interval_ms);
+void ga_garbage_destroy(ga_garbage *garbage);
+
+bool ga_garbage_push(ga_garbage *garbage, void *ptr, ga_garbage_destructor destructor);
+
+void ga_garbage_get_stats(ga_garbage *garbage, ga_garbage_stats *stats);
+
+#endif
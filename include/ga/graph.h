@@ -0,0 +1,102 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+
+#ifndef _GA_GRAPH
+#define _GA_GRAPH
+
+/*****************************************************************
+
+                PARALLEL AUDIO GRAPH SCHEDULER
+
+  Runs a graph of processors for one block at a time, spreading
+  the processors that are ready over a pool of realtime workers.
+
+  A ga_graph is built on a non-realtime thread: add nodes with
+  ga_graph_add_node, declare which nodes each node reads from with
+  ga_graph_connect, and call ga_graph_compile. The graph must be
+  acyclic, and can't be changed after compilation (build a new one
+  and swap it, e.g. with ga_ebr).
+
+  ga_graph_process runs one block, from the audio thread, which
+  also executes nodes itself. Each node has a dependency counter,
+  which is decremented when one of its inputs has finished; a node
+  is ready when it reaches zero, and then resets it for the next
+  block. Ready nodes are passed around in a ga_mpmcq. Nothing is
+  allocated and no locks are taken during a block.
+
+  Between blocks, workers spin for a short while (GA_GRAPH_SPIN_US)
+  waiting for the next block, and then go to sleep on an
+  eventcount.
+
+  If measuring is enabled, ga_graph_get_stats returns the number
+  of blocks, the total and maximum block time, and the time each
+  thread spent executing nodes (to compute core utilization).
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <ga/util.h>
+#include <ga/thread.h>
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_graph ga_graph;
+typedef struct ga_graph_scheduler ga_graph_scheduler;
+
+typedef void (* ga_graph_process_func)(void *data, unsigned int frames);
+
+#define GA_GRAPH_SPIN_US        50
+#define GA_GRAPH_MAX_THREADS    64
+
+typedef struct ga_graph_stats {
+    uint64_t blocks;
+    uint64_t total_ns;                          // Sum of block times
+    uint64_t max_ns;                            // Longest block
+    unsigned int threads;                       // Workers, plus the calling thread (index 0)
+    uint64_t busy_ns[GA_GRAPH_MAX_THREADS];     // Time spent executing nodes, per thread
+} ga_graph_stats;
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_graph* ga_graph_create(unsigned int max_nodes);
+void ga_graph_destroy(ga_graph *graph);
+int ga_graph_add_node(ga_graph *graph, ga_graph_process_func func, void *data);
+void ga_graph_connect(ga_graph *graph, int from, int to);
+void ga_graph_compile(ga_graph *graph);
+
+ga_graph_scheduler* ga_graph_scheduler_create(unsigned int workers, const ga_thread_attr *attr, bool measure);
+void ga_graph_scheduler_destroy(ga_graph_scheduler *scheduler);
+
+void ga_graph_process(ga_graph_scheduler *scheduler, ga_graph *graph, unsigned int frames);
+
+void ga_graph_get_stats(ga_graph_scheduler *scheduler, ga_graph_stats *stats);
+void ga_graph_reset_stats(ga_graph_scheduler *scheduler);
+
+#endif
@@ -0,0 +1,138 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+
+#ifndef _GA_HISTOGRAM
+#define _GA_HISTOGRAM
+
+/*****************************************************************
+
+                    LOG-LINEAR HISTOGRAMS
+
+  HDR style histograms of 64 bit values, typically latencies in
+  nanoseconds, for percentiles rather than averages.
+
+  Values below 2^GA_HISTOGRAM_SUB_BITS are counted exactly. Above
+  that, every power of two is split into 2^(GA_HISTOGRAM_SUB_BITS - 1)
+  linear buckets, so a value is known within 1/64 (1.6 %) of its
+  size, over the whole 64 bit range, in GA_HISTOGRAM_BUCKETS buckets.
+
+  ga_histogram_record neither blocks nor allocates, so it can be
+  called from realtime threads: three atomic additions, and no
+  compare and swap loops. Threads record into different shards
+  (chosen by a per-thread index) to avoid contending for the same
+  cache lines; the shards are merged when the histogram is read.
+  Reading while other threads record gives a slightly
+  inconsistent, but never invalid, view.
+
+  Each shard is about 30 kB. ga_histogram_create(0) makes one shard
+  per CPU.
+
+  Percentiles are reported as the highest value in their bucket.
+  ga_histogram_percentiles takes them in any order, but walks the
+  buckets only once when they are increasing.
+
+  The minimum and maximum are not recorded separately, but taken
+  as the lowest value of the lowest used bucket and the highest
+  value of the highest one, so they are exact below
+  GA_HISTOGRAM_SUB_COUNT and within the bucket resolution above.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <ga/util.h>
+#include "config.h"
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_histogram ga_histogram;
+
+#define GA_HISTOGRAM_SUB_BITS       7
+#define GA_HISTOGRAM_SUB_COUNT      (1 << GA_HISTOGRAM_SUB_BITS)
+#define GA_HISTOGRAM_BUCKETS        (GA_HISTOGRAM_SUB_COUNT + (64 - GA_HISTOGRAM_SUB_BITS) * (GA_HISTOGRAM_SUB_COUNT / 2))
+#define GA_HISTOGRAM_MAX_SHARDS     64
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_histogram* ga_histogram_create(unsigned int shards);
+void ga_histogram_destroy(ga_histogram *histogram);
+
+static inline void ga_histogram_record(ga_histogram *histogram, uint64_t value);
+void ga_histogram_reset(ga_histogram *histogram);
+void ga_histogram_merge(ga_histogram *histogram, ga_histogram *other);
+
+uint64_t ga_histogram_count(ga_histogram *histogram);
+uint64_t ga_histogram_min(ga_histogram *histogram);
+uint64_t ga_histogram_max(ga_histogram *histogram);
+double ga_histogram_mean(ga_histogram *histogram);
+uint64_t ga_histogram_percentile(ga_histogram *histogram, double percentile);
+void ga_histogram_percentiles(ga_histogram *histogram, const double *percentiles, uint64_t *values, unsigned int count);
+
+void ga_histogram_print(ga_histogram *histogram, FILE *file, const char *unit);
+void ga_histogram_print_json(ga_histogram *histogram, FILE *file);
+
+// "Private" stuff below
+// (Must be present in the header file to enable inlining)
+
+typedef struct ga_histogram_shard {
+    atomic_ullong count;
+    atomic_ullong sum;
+    atomic_ullong buckets[GA_HISTOGRAM_BUCKETS];
+} __attribute__((aligned(CACHELINE_SIZE))) ga_histogram_shard;
+
+struct ga_histogram {
+    unsigned int shard_count;
+    ga_histogram_shard *shards;
+};
+
+extern _Thread_local unsigned int ga_histogram_thread_index;
+unsigned int ga_histogram_assign_thread_index();
+
+static inline unsigned int ga_histogram_bucket(uint64_t value)
+{
+    if (value < GA_HISTOGRAM_SUB_COUNT) return value;
+    unsigned int shift = 64 - __builtin_clzll(value) - GA_HISTOGRAM_SUB_BITS;
+    unsigned int sub = (value >> shift) - GA_HISTOGRAM_SUB_COUNT / 2;
+    return GA_HISTOGRAM_SUB_COUNT + (shift - 1) * (GA_HISTOGRAM_SUB_COUNT / 2) + sub;
+}
+
+static inline void ga_histogram_record(ga_histogram *histogram, uint64_t value)
+{
+    unsigned int index = ga_histogram_thread_index;
+    if (!index) index = ga_histogram_assign_thread_index();
+    ga_histogram_shard *shard = &histogram->shards[index % histogram->shard_count];
+
+    atomic_fetch_add_explicit(&shard->buckets[ga_histogram_bucket(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->sum, value, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->count, 1, memory_order_release);
+}
+
+#endif
@@ -0,0 +1,104 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+#ifndef _GA_JITTER_BUFFER
+#define _GA_JITTER_BUFFER
+
+/*****************************************************************
+                  DRIFT COMPENSATING JITTER BUFFER
+
+  A FIFO of interleaved float frames between two clock domains,
+  e.g. two devices, or a network input feeding the engine. The
+  writer runs on one clock and the reader on another, so a plain
+  ring buffer slowly fills up or runs dry; this one keeps its fill
+  level at a fixed target by resampling on the reader side.
+
+  After each block, the reader measures the fill level (frames in
+  the ring buffer plus frames held by the resampler), smooths it,
+  and feeds the difference from the target to a PI controller,
+  whose output is a tiny ratio correction for a ga_resampler: a
+  buffer that fills up is read slightly faster, and one that
+  drains slightly slower. The integral term learns the steady
+  drift between the clocks, so the fill level converges to the
+  target instead of settling next to it.
+
+  The time constant (ga_jitter_buffer_set_time_constant, by
+  default GA_JITTER_BUFFER_TIME_CONSTANT seconds) sets how quickly
+  the fill level is pulled back: shorter follows faster, longer
+  gives smaller and smoother ratio changes. Corrections are limited
+  to +/- GA_JITTER_BUFFER_MAX_PPM.
+
+  The reader outputs silence until the buffer has filled up to the
+  target. If it runs dry anyway, the underrun is counted and it
+  waits for the target fill again, keeping what the controller has
+  learned. If the writer finds the buffer full, the frames that
+  don't fit are dropped and counted as an overflow.
+
+  There is a single writer thread (ga_jitter_buffer_write) and a
+  single reader thread (ga_jitter_buffer_read); neither allocates
+  or blocks. ga_jitter_buffer_get_stats can be called from any
+  thread.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <ga/util.h>
+#include <ga/resampler.h>
+
+#define GA_JITTER_BUFFER_TIME_CONSTANT  5.0
+#define GA_JITTER_BUFFER_MAX_PPM        5000.0
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_jitter_buffer ga_jitter_buffer;
+
+typedef struct ga_jitter_buffer_stats {
+    double      fill;               //  Frames buffered after the last read
+    double      average_fill;       //  Smoothed fill level, as seen by the controller
+    size_t      target;             //  Target fill level, in frames
+    double      ratio;              //  Current resampling ratio (output / input)
+    double      ppm;                //  Current correction, in parts per million
+    uint64_t    frames_written;
+    uint64_t    frames_read;
+    uint64_t    underruns;
+    uint64_t    overflows;
+} ga_jitter_buffer_stats;
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_jitter_buffer* ga_jitter_buffer_create(unsigned int channels, double sample_rate, size_t target_frames, size_t capacity_frames, ga_resampler_quality quality);
+void ga_jitter_buffer_destroy(ga_jitter_buffer *buffer);
+void ga_jitter_buffer_set_time_constant(ga_jitter_buffer *buffer, double seconds);
+
+size_t ga_jitter_buffer_write(ga_jitter_buffer *buffer, const float *data, size_t frames);
+size_t ga_jitter_buffer_read(ga_jitter_buffer *buffer, float *data, size_t frames);
+
+void ga_jitter_buffer_get_stats(ga_jitter_buffer *buffer, ga_jitter_buffer_stats *stats);
+
+#endif
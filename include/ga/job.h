@@ -0,0 +1,90 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+
+#ifndef _GA_JOB
+#define _GA_JOB
+
+/*****************************************************************
+
+                    WORK STEALING JOB SYSTEM
+
+  A fixed pool of worker threads, each with its own Chase-Lev
+  deque of jobs. Workers pop jobs from the bottom of their own
+  deque, and steal from the top of a random other worker's when
+  it is empty. Idle workers sleep on an eventcount, so that
+  scheduling a job costs no system call unless a worker sleeps,
+  and then wakes only one of them.
+
+  A job is created with ga_job_create, or ga_job_create_child to
+  make it a child of another job. A job is not finished until its
+  function has returned and all its children have finished.
+  Continuations (at most GA_JOB_MAX_CONTINUATIONS per job) are
+  scheduled when the job finishes, and must be added before the
+  job is run.
+
+  ga_job_run schedules a job. ga_job_wait waits for a job to
+  finish, executing other jobs in the meantime instead of blocking.
+
+  Jobs can only be created, run and waited for from the worker
+  threads and from the thread that created the job system. Each
+  of these threads has a ring of GA_JOB_MAX_JOBS jobs, which are
+  reused without freeing; a thread must not have more than that
+  many unfinished jobs at a time. No allocation happens after
+  ga_job_system_create.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <ga/util.h>
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_job_system ga_job_system;
+typedef struct ga_job ga_job;
+
+typedef void (* ga_job_func)(ga_job_system*, ga_job*, void*);
+
+#define GA_JOB_MAX_JOBS             4096
+#define GA_JOB_MAX_CONTINUATIONS    3
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_job_system* ga_job_system_create(unsigned int workers);
+void ga_job_system_destroy(ga_job_system *system);
+unsigned int ga_job_system_worker_count(ga_job_system *system);
+
+ga_job* ga_job_create(ga_job_system *system, ga_job_func func, void *data);
+ga_job* ga_job_create_child(ga_job_system *system, ga_job *parent, ga_job_func func, void *data);
+void ga_job_add_continuation(ga_job *job, ga_job *continuation);
+
+void ga_job_run(ga_job_system *system, ga_job *job);
+void ga_job_wait(ga_job_system *system, ga_job *job);
+bool ga_job_is_finished(ga_job *job);
+
+#endif
@@ -0,0 +1,103 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+
+#ifndef _GA_LOCK
+#define _GA_LOCK
+
+/*****************************************************************
+
+                    LOCKS AND CONDITION VARIABLES
+
+  For non-realtime code. Realtime threads should not take locks,
+  but if a lock really has to be shared with a realtime thread,
+  use a ga_mutex.
+
+  ga_mutex
+    A mutex with priority inheritance (PTHREAD_PRIO_INHERIT, where
+    supported): a low priority thread holding the mutex is boosted
+    to the priority of the highest priority thread waiting for it.
+
+  ga_spinlock
+    For short critical sections. Spins for a while (with
+    ga_cpu_relax), and then parks the thread on a futex. Unlocking
+    only makes a system call if a thread is parked.
+
+  ga_cond
+    A condition variable, used with a ga_mutex. Timeouts of
+    ga_cond_timed_wait are measured on the monotonic clock, so
+    changes to the system time don't affect them.
+
+  If created with stats = true, a lock counts acquisitions,
+  contended acquisitions (where the lock was already taken) and
+  the total time spent waiting for it. The counters are written by
+  the thread holding the lock, so they cost nothing when disabled
+  and very little when enabled.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <ga/util.h>
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_mutex ga_mutex;
+typedef struct ga_spinlock ga_spinlock;
+typedef struct ga_cond ga_cond;
+
+typedef struct ga_lock_stats {
+    uint64_t acquires;
+    uint64_t contended;
+    uint64_t wait_ns;
+} ga_lock_stats;
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_mutex* ga_mutex_create(bool stats);
+void ga_mutex_destroy(ga_mutex *mutex);
+void ga_mutex_lock(ga_mutex *mutex);
+bool ga_mutex_try_lock(ga_mutex *mutex);
+void ga_mutex_unlock(ga_mutex *mutex);
+void ga_mutex_get_stats(ga_mutex *mutex, ga_lock_stats *stats);
+
+ga_spinlock* ga_spinlock_create(bool stats);
+void ga_spinlock_destroy(ga_spinlock *lock);
+void ga_spinlock_lock(ga_spinlock *lock);
+bool ga_spinlock_try_lock(ga_spinlock *lock);
+void ga_spinlock_unlock(ga_spinlock *lock);
+void ga_spinlock_get_stats(ga_spinlock *lock, ga_lock_stats *stats);
+
+ga_cond* ga_cond_create();
+void ga_cond_destroy(ga_cond *cond);
+void ga_cond_wait(ga_cond *cond, ga_mutex *mutex);
+bool ga_cond_timed_wait(ga_cond *cond, ga_mutex *mutex, unsigned int ms);
+void ga_cond_signal(ga_cond *cond);
+void ga_cond_broadcast(ga_cond *cond);
+
+#endif
@@ -0,0 +1,141 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+
+#ifndef _GA_LOG
+#define _GA_LOG
+
+/*****************************************************************
+
+                        DEFERRED LOGGING
+
+  Logging that is safe from realtime threads: nothing is
+  formatted, allocated or written on the calling thread.
+
+    ga_log_info("Loaded %s (%d frames)", path, frames);
+    ga_log_warning("xrun at frame %llu", frame);
+
+  A message is the format string pointer, a timestamp and the raw
+  arguments, copied into a ring buffer belonging to the calling
+  thread (allocated when the thread first logs, so hot threads
+  should call ga_log_register_thread first; messages logged inside
+  a realtime section before that are dropped). Messages are labelled
+  with the name given there, or to ga_log_set_thread_name (which
+  doesn't allocate, and is called for named ga_threads). %s
+  arguments are copied too, truncated to GA_LOG_MAX_STRING bytes;
+  the format string itself must stay valid (a literal). At most
+  GA_LOG_MAX_ARGS arguments are kept. If the ring is full, the message is dropped
+  and counted.
+
+  A background thread, started with ga_log_start, formats the
+  messages and writes them to a file (stderr by default). Before
+  ga_log_start and after ga_log_stop, messages are formatted and
+  written right away, on the calling thread; inside a realtime
+  section they are dropped and counted instead.
+
+  Levels below GA_LOG_COMPILE_LEVEL (GA_LOG_DEBUG in debug builds,
+  GA_LOG_INFO otherwise) are compiled out. ga_log_set_level filters
+  further at runtime.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <ga/util.h>
+
+/*
+ *  TYPES
+ */
+
+#define GA_LOG_ERROR        1
+#define GA_LOG_WARNING      2
+#define GA_LOG_INFO         3
+#define GA_LOG_DEBUG        4
+
+#ifndef GA_LOG_COMPILE_LEVEL
+#if GA_DEBUG
+#define GA_LOG_COMPILE_LEVEL GA_LOG_DEBUG
+#else
+#define GA_LOG_COMPILE_LEVEL GA_LOG_INFO
+#endif
+#endif
+
+#define GA_LOG_MAX_ARGS         8
+#define GA_LOG_MAX_STRING       64
+#define GA_LOG_BUFFER_SIZE      (64 * 1024)
+
+/*
+ *  FUNCTIONS
+ */
+
+bool ga_log_start(FILE *file, unsigned int interval_ms);
+void ga_log_stop();
+void ga_log_flush();
+
+void ga_log_set_level(int level);
+int ga_log_get_level();
+uint64_t ga_log_dropped();
+
+void ga_log_register_thread(const char *name);
+void ga_log_set_thread_name(const char *name);
+
+void ga_log_write(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+#define GA_LOG_IF(level, ...) \
+    do { \
+        if ((level) <= atomic_load_explicit(&ga_log_level, memory_order_relaxed)) ga_log_write(level, __VA_ARGS__); \
+    } while (0)
+
+#if GA_LOG_COMPILE_LEVEL >= GA_LOG_ERROR
+#define ga_log_error(...)       GA_LOG_IF(GA_LOG_ERROR, __VA_ARGS__)
+#else
+#define ga_log_error(...)       do {} while (0)
+#endif
+
+#if GA_LOG_COMPILE_LEVEL >= GA_LOG_WARNING
+#define ga_log_warning(...)     GA_LOG_IF(GA_LOG_WARNING, __VA_ARGS__)
+#else
+#define ga_log_warning(...)     do {} while (0)
+#endif
+
+#if GA_LOG_COMPILE_LEVEL >= GA_LOG_INFO
+#define ga_log_info(...)        GA_LOG_IF(GA_LOG_INFO, __VA_ARGS__)
+#else
+#define ga_log_info(...)        do {} while (0)
+#endif
+
+#if GA_LOG_COMPILE_LEVEL >= GA_LOG_DEBUG
+#define ga_log_debug(...)       GA_LOG_IF(GA_LOG_DEBUG, __VA_ARGS__)
+#else
+#define ga_log_debug(...)       do {} while (0)
+#endif
+
+// "Private" stuff below
+// (Must be present in the header file to enable inlining)
+
+extern atomic_int ga_log_level;
+
+#endif
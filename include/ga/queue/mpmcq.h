@@ -34,6 +34,13 @@
 
   No (heap) memory allocation is performed in the queue (after creation).
 
+  ga_mpmcq_create_with_flags takes ga_mem_flags (see ga/alloc.h)
+  for the queue storage, e.g. GA_MEM_REALTIME for queues that are
+  used from realtime threads.
+
+  ga_mpmcq_enable_stats registers the queue for telemetry (see
+  ga/queue/stats.h). Empty stalls are not counted, since there is
+  no single consumer to tell them from other consumers' underflows.
 
 
  *****************************************************************/
@@ -41,6 +48,8 @@
 #include <stdlib.h>
 #include <ga/util.h>
 #include <ga/error.h>
+#include <ga/alloc.h>
+#include <ga/queue/stats.h>
 
 /*
  *  TYPES
@@ -53,6 +62,9 @@ typedef struct ga_mpmcq ga_mpmcq;
  */
 
 ga_mpmcq* ga_mpmcq_create(size_t capacity);
+ga_mpmcq* ga_mpmcq_create_with_flags(size_t capacity, ga_mem_flags flags);
+void ga_mpmcq_enable_stats(ga_mpmcq *queue, const char *name);
+void ga_mpmcq_get_stats(ga_mpmcq *queue, ga_queue_stats *stats);
 void ga_mpmcq_destroy(ga_mpmcq *queue);
 
 bool ga_mpmcq_push(ga_mpmcq *queue, void *value);
@@ -33,6 +33,9 @@
   a single consumer thread.
 
   No (heap) memory allocation is performed in the queue (after creation).
+  ga_spscq_create_with_flags takes ga_mem_flags (see ga/alloc.h) for
+  the queue storage, e.g. GA_MEM_REALTIME for queues used from
+  realtime threads.
 
   It is always safe to call ga_spscq_push, ga_spscq_peek and
   ga_spscq_pop, in the sense that the calls will never crash
@@ -76,11 +79,22 @@
     - a error value [void*]  (On GA_ERROR_OVERFLOW, this is the value that couldn't be written)
     - the data parameter passed to ga_spscq_set_error_callback [void*]
 
+  ga_spscq_enable_stats registers the queue for telemetry (see
+  ga/queue/stats.h). ga_spscq_get_stats works either way, but only
+  the depth and overflows are tracked without it.
+
+  With SPSCQ_OVERFLOW_BLOCK, ga_spscq_set_histogram installs a
+  ga_histogram receiving the time (in ns) of every push that had
+  to wait.
+
  *****************************************************************/
 
 #include <stdlib.h>
 #include <ga/util.h>
 #include <ga/error.h>
+#include <ga/alloc.h>
+#include <ga/histogram.h>
+#include <ga/queue/stats.h>
 
 /*
  *  TYPES
@@ -104,9 +118,13 @@ typedef void (* ga_spscq_callback)(ga_spscq*, ga_error, void*, void*);
  */
 
 ga_spscq* ga_spscq_create(size_t capacity, ga_spscq_overflow_strategy on_overflow);
+ga_spscq* ga_spscq_create_with_flags(size_t capacity, ga_spscq_overflow_strategy on_overflow, ga_mem_flags flags);
 void ga_spscq_destroy(ga_spscq *queue);
 
 void ga_spscq_set_error_callback(ga_spscq *queue, ga_spscq_callback callback, void *data);
+void ga_spscq_set_histogram(ga_spscq *queue, ga_histogram *histogram);
+void ga_spscq_enable_stats(ga_spscq *queue, const char *name);
+void ga_spscq_get_stats(ga_spscq *queue, ga_queue_stats *stats);
 
 size_t ga_spscq_can_push(ga_spscq *queue);
 size_t ga_spscq_can_pop(ga_spscq *queue);
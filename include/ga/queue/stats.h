@@ -0,0 +1,155 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+
+#ifndef _GA_QUEUE_STATS
+#define _GA_QUEUE_STATS
+
+/*****************************************************************
+
+                        QUEUE TELEMETRY
+
+  Optional statistics for ga_spscq, ga_mpmcq and ga_ring_buffer,
+  enabled per queue with ga_spscq_enable_stats (etc.), which also
+  registers the queue by name. ga_queue_registry_snapshot reads the
+  statistics of every registered queue, e.g. to size queues from
+  production data.
+
+    depth, high_water   Current and highest number of items (bytes
+                        for ring buffers)
+    pushes, pops        Successful operations
+    overflows           Pushes that found the queue full
+    underflows          Pops that found the queue empty
+    full_stalls         Pushes that waited for room
+                        (SPSCQ_OVERFLOW_BLOCK)
+    empty_stalls        Times the consumer ran the queue dry: pops
+                        finding it empty right after a successful pop
+
+  The counters are updated with relaxed loads and stores by the
+  thread that owns them (the producer or the consumer side), so
+  they cost a predictable branch and a few stores. ga_mpmcq counts
+  pushes and pops from its positions for free, but has no single
+  owner, so it uses relaxed atomic additions for the other counters.
+
+  Enable stats before the queue is shared between threads.
+  Destroying a queue unregisters it. The name in a snapshot is only
+  valid while its queue is alive.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <ga/util.h>
+#include "config.h"
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_queue_stats {
+    const char  *name;
+    const char  *kind;              //  "spscq", "mpmcq" or "ring_buffer"
+    size_t      capacity;
+    size_t      depth;
+    size_t      high_water;
+    uint64_t    pushes;
+    uint64_t    pops;
+    uint64_t    overflows;
+    uint64_t    underflows;
+    uint64_t    full_stalls;
+    uint64_t    empty_stalls;
+} ga_queue_stats;
+
+typedef void (* ga_queue_stats_func)(void *queue, ga_queue_stats *stats);
+
+/*
+ *  FUNCTIONS
+ */
+
+size_t ga_queue_registry_count();
+size_t ga_queue_registry_snapshot(ga_queue_stats *stats, size_t max);
+void ga_queue_registry_print(FILE *file);
+
+// "Private" stuff below
+// (Must be present in the header file to enable inlining)
+
+typedef struct ga_queue_counters {
+    // Written by the producer
+    atomic_ullong   pushes;
+    atomic_ullong   overflows;
+    atomic_ullong   full_stalls;
+    atomic_size_t   high_water;
+    char            pad[CACHELINE_SIZE - 3 * sizeof(atomic_ullong) - sizeof(atomic_size_t)];
+    // Written by the consumer
+    atomic_ullong   pops;
+    atomic_ullong   underflows;
+    atomic_ullong   empty_stalls;
+    bool            was_empty;
+    char            *name;
+} __attribute__((aligned(CACHELINE_SIZE))) ga_queue_counters;
+
+ga_queue_counters* ga_queue_register(const char *name, const char *kind, void *queue, ga_queue_stats_func func);
+void ga_queue_unregister(ga_queue_counters *counters);
+
+static inline void ga_queue_count(atomic_ullong *counter)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+static inline void ga_queue_count_depth(ga_queue_counters *counters, size_t depth)
+{
+    if (depth > atomic_load_explicit(&counters->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&counters->high_water, depth, memory_order_relaxed);
+    }
+}
+
+// A pop, successful or not, by the consumer
+static inline void ga_queue_count_pop(ga_queue_counters *counters, bool success)
+{
+    if (success) {
+        ga_queue_count(&counters->pops);
+        counters->was_empty = false;
+    } else {
+        ga_queue_count(&counters->underflows);
+        if (!counters->was_empty) ga_queue_count(&counters->empty_stalls);
+        counters->was_empty = true;
+    }
+}
+
+// Copies the counters into stats (depth and capacity are up to the queue)
+static inline void ga_queue_read_counters(ga_queue_counters *counters, ga_queue_stats *stats)
+{
+    stats->name         = counters->name;
+    stats->high_water   = atomic_load_explicit(&counters->high_water, memory_order_relaxed);
+    stats->pushes       = atomic_load_explicit(&counters->pushes, memory_order_relaxed);
+    stats->pops         = atomic_load_explicit(&counters->pops, memory_order_relaxed);
+    stats->overflows    = atomic_load_explicit(&counters->overflows, memory_order_relaxed);
+    stats->underflows   = atomic_load_explicit(&counters->underflows, memory_order_relaxed);
+    stats->full_stalls  = atomic_load_explicit(&counters->full_stalls, memory_order_relaxed);
+    stats->empty_stalls = atomic_load_explicit(&counters->empty_stalls, memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+#ifndef _GA_REALTIME
+#define _GA_REALTIME
+
+/*****************************************************************
+
+                    REALTIME SECTIONS
+
+  Marks the parts of a thread that must not do anything that
+  can block, e.g. the audio callback. Sections can be nested.
+
+    ga_realtime_enter();
+    ... process audio ...
+    ga_realtime_exit();
+
+  Calls to ga_malloc, ga_free, ga_realloc (and everything built
+  on them, such as ga_sprintf) and ga_thread_create inside a
+  realtime section are violations. What happens on a violation
+  is set with ga_realtime_set_action:
+
+    GA_REALTIME_COUNT
+      The violation is counted (default)
+
+    GA_REALTIME_LOG
+      The violation is counted, and logged with the function
+      and the call site address
+
+    GA_REALTIME_ABORT
+      The violation is logged, and the application is aborted
+
+  Checking is a single thread local load, so it can be left on
+  in production builds.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <assert.h>
+#include <ga/util.h>
+
+/*
+ *  TYPES
+ */
+
+typedef enum ga_realtime_action {
+    GA_REALTIME_COUNT,
+    GA_REALTIME_LOG,
+    GA_REALTIME_ABORT
+} ga_realtime_action;
+
+/*
+ *  FUNCTIONS
+ */
+
+static inline void ga_realtime_enter();
+static inline void ga_realtime_exit();
+static inline bool ga_realtime_is_active();
+
+void ga_realtime_set_action(ga_realtime_action action);
+size_t ga_realtime_violations();
+
+// Check for a violation in a function that isn't allowed in realtime sections
+#define ga_realtime_check(func) \
+    do { if (ga_realtime_depth) ga_realtime_violation(func, __builtin_return_address(0)); } while (0)
+
+// "Private" stuff below
+// (Must be present in the header file to enable inlining)
+
+extern _Thread_local unsigned int ga_realtime_depth;
+
+void ga_realtime_violation(const char *func, void *call_site);
+
+static inline void ga_realtime_enter()
+{
+    ga_realtime_depth++;
+}
+
+static inline void ga_realtime_exit()
+{
+    assert(ga_realtime_depth > 0 && "Not in a realtime section");
+    ga_realtime_depth--;
+}
+
+static inline bool ga_realtime_is_active()
+{
+    return ga_realtime_depth > 0;
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+#ifndef _GA_RESAMPLER
+#define _GA_RESAMPLER
+
+/*****************************************************************
+                   STREAMING SAMPLE RATE CONVERTER
+
+  Converts a stream of interleaved float frames, read from a
+  ga_ring_buffer, to another sample rate, one block at a time, so
+  that imported material can be played at the engine rate without
+  being resampled up front.
+
+  The ratio is the output rate divided by the input rate. It can
+  be anything between the min_ratio and max_ratio given at
+  creation, and can be changed between blocks with
+  ga_resampler_set_ratio (e.g. for varispeed, or to follow clock
+  drift). The anti-aliasing filter is designed for min_ratio, so
+  a wide range costs filter length.
+
+  The filter is a Kaiser windowed sinc, stored as a polyphase
+  table; each output sample interpolates between the two nearest
+  phases, so any ratio works. The dot products use the vector
+  kernels in ga/dsp.h. The quality presets trade filter length
+  and phase resolution for CPU time:
+
+    GA_RESAMPLER_FAST       16 taps, 64 phases
+    GA_RESAMPLER_MEDIUM     32 taps, 128 phases
+    GA_RESAMPLER_BEST       64 taps, 256 phases
+
+  (taps are for ratios >= 0.98, and grow by 1/min_ratio below
+  that, rounded up to whole vectors of the selected kernels).
+
+  ga_resampler_process produces the requested number of frames
+  into an interleaved output buffer, reading only whole frames from
+  the source as needed. If the source runs dry, the rest of the
+  block is filled with silence, an underrun is counted, and the
+  number of frames actually produced is returned. Nothing is
+  allocated after creation, and the resampler is used by one
+  thread at a time (set_ratio and reset included).
+
+  To run as a ga_graph node, set the source and output buffer with
+  ga_resampler_set_io and add ga_resampler_process_node with the
+  resampler as data.
+
+  The stream starts at ga_resampler_reset (and creation). The
+  filter needs ga_resampler_latency input frames beyond the current
+  position before it produces a frame.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <ga/util.h>
+#include <ga/ring_buffer.h>
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_resampler ga_resampler;
+
+typedef enum {
+    GA_RESAMPLER_FAST,
+    GA_RESAMPLER_MEDIUM,
+    GA_RESAMPLER_BEST
+} ga_resampler_quality;
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_resampler* ga_resampler_create(unsigned int channels, ga_resampler_quality quality, double min_ratio, double max_ratio);
+void ga_resampler_destroy(ga_resampler *resampler);
+void ga_resampler_reset(ga_resampler *resampler);
+
+bool ga_resampler_set_ratio(ga_resampler *resampler, double ratio);
+double ga_resampler_get_ratio(ga_resampler *resampler);
+unsigned int ga_resampler_latency(ga_resampler *resampler);
+double ga_resampler_buffered(ga_resampler *resampler);
+uint64_t ga_resampler_underruns(ga_resampler *resampler);
+
+size_t ga_resampler_process(ga_resampler *resampler, ga_ring_buffer *source, float *output, size_t frames);
+
+void ga_resampler_set_io(ga_resampler *resampler, ga_ring_buffer *source, float *output);
+void ga_resampler_process_node(void *data, unsigned int frames);
+
+#endif
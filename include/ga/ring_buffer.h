@@ -33,6 +33,10 @@
 
   No (heap) memory allocation is performed in the ring_buffer (after creation).
 
+  ga_ring_buffer_create_with_flags takes ga_mem_flags (see ga/alloc.h)
+  for the buffer memory. Pass GA_MEM_REALTIME for buffers that are
+  used from realtime threads, to avoid page faults on first use.
+
   It is always safe to call the read and write functions
   (ga_ring_buffer_read, ga_ring_buffer_write etc),
   in the sense that the calls will never crash or block
@@ -56,6 +60,10 @@
   contain the requested number of bytes, the function returns 0
   and leaves the passed buffer untouched.
 
+  ga_ring_buffer_skip discards up to the passed number of bytes
+  without copying them (from the consumer thread), and returns the
+  number of bytes discarded. It counts as a read in the statistics.
+
   An error handler can be installed using ga_ring_buffer_set_error_callback.
   The callback should take three parameters:
     - the ring buffer [ga_ring_buffer*]
@@ -71,6 +79,8 @@
 #include <stdlib.h>
 #include <ga/util.h>
 #include <ga/error.h>
+#include <ga/alloc.h>
+#include <ga/queue/stats.h>
 
 /*
  *  TYPES
@@ -85,6 +95,9 @@ typedef void (* ga_ring_buffer_callback)(ga_ring_buffer*, ga_error, void*);
  */
 
 ga_ring_buffer* ga_ring_buffer_create(size_t size);
+ga_ring_buffer* ga_ring_buffer_create_with_flags(size_t size, ga_mem_flags flags);
+void ga_ring_buffer_enable_stats(ga_ring_buffer *ring_buffer, const char *name);
+void ga_ring_buffer_get_stats(ga_ring_buffer *ring_buffer, ga_queue_stats *stats);
 void ga_ring_buffer_destroy(ga_ring_buffer *ring_buffer);
 
 void ga_ring_buffer_set_error_callback(ga_ring_buffer *ring_buffer, ga_ring_buffer_callback callback, void *data);
@@ -95,6 +108,7 @@ size_t ga_ring_buffer_write(ga_ring_buffer *ring_buffer, size_t bytes, void *dat
 size_t ga_ring_buffer_write_atomic(ga_ring_buffer *ring_buffer, size_t bytes, void *data);
 size_t ga_ring_buffer_read(ga_ring_buffer *ring_buffer, size_t bytes, void *data);
 size_t ga_ring_buffer_read_atomic(ga_ring_buffer *ring_buffer, size_t bytes, void *data);
+size_t ga_ring_buffer_skip(ga_ring_buffer *ring_buffer, size_t bytes);
 
 void debug_ring_buffer(ga_ring_buffer *ring_buffer);
 
@@ -1,31 +1,106 @@
+#ifndef _GA_SEMAPHORE
+#define _GA_SEMAPHORE
+
+/*****************************************************************
+
+                    COUNTING SEMAPHORES
+
+  Semaphores are identified by an int id, from ga_semaphore_acquire,
+  and returned with ga_semaphore_release. Both are lock free and
+  O(1) amortized: the semaphores live in cacheline padded blocks
+  of 64, and each block has a bitmap of used slots. Blocks are
+  allocated when needed, up to the capacity set with
+  ga_semaphore_set_capacity (GA_SEMAPHORE_DEFAULT_CAPACITY by
+  default). ga_semaphore_reserve allocates blocks up front, so
+  that ga_semaphore_acquire never allocates.
+
+  ga_semaphore_post increments the count. It never blocks, and only
+  makes a system call if there are threads waiting, so it is safe
+  to call from realtime threads. It wakes one waiter, and
+  ga_semaphore_set up to as many as the new count.
+
+  ga_semaphore_wait decrements the count, waiting for it to become
+  positive first. It spins briefly, and then sleeps (see
+  ga/futex.h). ga_semaphore_timed_wait gives up after the given
+  number of milliseconds and returns false, and
+  ga_semaphore_try_wait never waits.
+
+  ga_semaphore_get and ga_semaphore_set read and write the count
+  directly, so a semaphore can also be used as a status cell.
+
+ *****************************************************************/
+
 #include <stdatomic.h>
 #include <ga/util.h>
 #include "config.h"
 
+#define GA_SEMAPHORE_BLOCK_SIZE         64
+#define GA_SEMAPHORE_MAX_BLOCKS         1024
+#define GA_SEMAPHORE_DEFAULT_CAPACITY   4096
+
 int ga_semaphore_acquire(unsigned int initial_value);
 void ga_semaphore_release(int id);
+void ga_semaphore_set_capacity(unsigned int capacity);
+void ga_semaphore_reserve(unsigned int count);
 static inline unsigned int ga_semaphore_get(int id);
 static inline void ga_semaphore_set(int id, unsigned int value);
 
+static inline void ga_semaphore_post(int id);
+static inline bool ga_semaphore_try_wait(int id);
+void ga_semaphore_wait(int id);
+bool ga_semaphore_timed_wait(int id, unsigned int ms);
+
 // "Private" stuff below
 // (Must be present in the header file to enable inlining)
 
 typedef struct ga_semaphore
 {
     atomic_uint status;
-    atomic_uint used;
+    atomic_uint waiters;
     char pad[CACHELINE_SIZE - (sizeof(atomic_uint) * 2)];
 } ga_semaphore;
 
+void ga_semaphore_wake(int id, unsigned int count);
+
+static inline ga_semaphore* ga_semaphore_ptr(int id)
+{
+    extern ga_semaphore *_Atomic ga_semaphore_blocks[];
+    ga_semaphore *block = atomic_load_explicit(&ga_semaphore_blocks[id / GA_SEMAPHORE_BLOCK_SIZE], memory_order_relaxed);
+    return &block[id % GA_SEMAPHORE_BLOCK_SIZE];
+}
+
 static inline unsigned int ga_semaphore_get(int id)
 {
-    extern ga_semaphore ga_semaphores[];
-    return atomic_load_explicit(&ga_semaphores[id].status, memory_order_acquire);
+    ga_semaphore *semaphore = ga_semaphore_ptr(id);
+    return atomic_load_explicit(&semaphore->status, memory_order_acquire);
 }
 
 static inline void ga_semaphore_set(int id, unsigned int value)
 {
-    extern ga_semaphore ga_semaphores[];
-    atomic_store_explicit(&ga_semaphores[id].status, value, memory_order_release);
+    ga_semaphore *semaphore = ga_semaphore_ptr(id);
+    atomic_store_explicit(&semaphore->status, value, memory_order_seq_cst);
+    if (value && atomic_load_explicit(&semaphore->waiters, memory_order_seq_cst)) ga_semaphore_wake(id, value);
+}
+
+static inline void ga_semaphore_post(int id)
+{
+    ga_semaphore *semaphore = ga_semaphore_ptr(id);
+    atomic_fetch_add_explicit(&semaphore->status, 1, memory_order_seq_cst);
+    // Only one waiter can take the new count, so don't wake the others
+    if (atomic_load_explicit(&semaphore->waiters, memory_order_seq_cst)) ga_semaphore_wake(id, 1);
+}
+
+static inline bool ga_semaphore_try_wait(int id)
+{
+    ga_semaphore *semaphore = ga_semaphore_ptr(id);
+    unsigned int value = atomic_load_explicit(&semaphore->status, memory_order_relaxed);
+    while (value > 0) {
+        if (atomic_compare_exchange_weak_explicit(&semaphore->status, &value, value - 1,
+                                                  memory_order_acquire, memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
 }
 
+#endif
@@ -0,0 +1,219 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+#ifndef _GA_SEQLOCK
+#define _GA_SEQLOCK
+
+/*****************************************************************
+                            SEQLOCK
+
+  A sequence lock for state that is written by one thread and read
+  by many: meter banks, the transport position, tempo maps. Readers
+  get a consistent multi-word snapshot without writing to shared
+  memory, so they never slow down the writer or each other.
+
+  The writer increments the sequence before and after an update,
+  so it is odd while an update is in progress. A reader copies the
+  data and checks that the sequence was even and unchanged; if not,
+  the copy may be torn and it tries again.
+
+  ga_seqlock is embedded next to the data it protects and set up
+  with ga_seqlock_init. ga_seqlock_write copies a whole update in,
+  ga_seqlock_read copies a snapshot out and gives up after the given
+  number of retries (returning false, and leaving a possibly torn
+  copy in dst), so a reader on a realtime thread has a bounded cost.
+  Pass GA_SEQLOCK_RETRY_FOREVER to keep trying.
+
+  The data is copied with relaxed atomic word accesses, between the
+  fences of the sequence updates, so the races the sequence
+  detects are well defined in C11. For the same reason, the
+  protected data must only be accessed with these functions (or
+  with ga_seqlock_write_begin/ga_seqlock_write_end around
+  ga_seqlock_store).
+
+  ga_seqlock_array is an array of equally sized banks, each with its
+  own sequence, e.g. one bank of meters per track. A writer updating
+  one bank doesn't make readers of the other banks retry.
+  ga_seqlock_array_sequence reads the sequence of a bank, which a
+  reader can compare with the one ga_seqlock_array_read returned
+  last time, to skip banks that haven't changed. A bank has a single
+  writer, but different banks may have different writers.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <ga/util.h>
+#include <ga/alloc.h>
+#include "config.h"
+
+#define GA_SEQLOCK_RETRY_FOREVER    ((unsigned int)-1)
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_seqlock {
+    atomic_uint sequence;
+} ga_seqlock;
+
+typedef struct ga_seqlock_array ga_seqlock_array;
+
+/*
+ *  FUNCTIONS
+ */
+
+static inline void ga_seqlock_init(ga_seqlock *lock);
+static inline void ga_seqlock_write(ga_seqlock *lock, void *dst, const void *src, size_t size);
+static inline bool ga_seqlock_read(ga_seqlock *lock, void *dst, const void *src, size_t size, unsigned int retries);
+
+// Lower level, for writers updating parts of the data
+static inline void ga_seqlock_write_begin(ga_seqlock *lock);
+static inline void ga_seqlock_write_end(ga_seqlock *lock);
+static inline void ga_seqlock_store(void *dst, const void *src, size_t size);
+
+ga_seqlock_array* ga_seqlock_array_create(size_t banks, size_t bank_size);
+ga_seqlock_array* ga_seqlock_array_create_with_flags(size_t banks, size_t bank_size, ga_mem_flags flags);
+void ga_seqlock_array_destroy(ga_seqlock_array *array);
+size_t ga_seqlock_array_banks(ga_seqlock_array *array);
+size_t ga_seqlock_array_bank_size(ga_seqlock_array *array);
+static inline void ga_seqlock_array_write(ga_seqlock_array *array, size_t bank, const void *data);
+static inline bool ga_seqlock_array_read(ga_seqlock_array *array, size_t bank, void *data, unsigned int retries, unsigned int *sequence);
+static inline unsigned int ga_seqlock_array_sequence(ga_seqlock_array *array, size_t bank);
+
+// "Private" stuff below
+// (Must be present in the header file to enable inlining)
+
+struct ga_seqlock_array {
+    size_t  banks;
+    size_t  bank_size;
+    size_t  stride;         //  Bytes per bank, sequence included, rounded up to a cache line
+    void    *data;
+};
+
+// Each bank starts with its sequence, followed by the (word aligned) data
+#define GA_SEQLOCK_BANK_HEADER  sizeof(uint64_t)
+
+static inline void ga_seqlock_store(void *dst, const void *src, size_t size)
+{
+    size_t i = 0;
+    if (!(((uintptr_t)dst | (uintptr_t)src) & (sizeof(uint64_t) - 1))) {
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            __atomic_store_n((uint64_t*)(dst + i), *(const uint64_t*)(src + i), __ATOMIC_RELAXED);
+        }
+    }
+    for (; i < size; i++) {
+        __atomic_store_n((uint8_t*)(dst + i), *(const uint8_t*)(src + i), __ATOMIC_RELAXED);
+    }
+}
+
+static inline void ga_seqlock_load(void *dst, const void *src, size_t size)
+{
+    size_t i = 0;
+    if (!(((uintptr_t)dst | (uintptr_t)src) & (sizeof(uint64_t) - 1))) {
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            *(uint64_t*)(dst + i) = __atomic_load_n((const uint64_t*)(src + i), __ATOMIC_RELAXED);
+        }
+    }
+    for (; i < size; i++) {
+        *(uint8_t*)(dst + i) = __atomic_load_n((const uint8_t*)(src + i), __ATOMIC_RELAXED);
+    }
+}
+
+static inline void ga_seqlock_init(ga_seqlock *lock)
+{
+    atomic_init(&lock->sequence, 0);
+}
+
+static inline void ga_seqlock_write_begin(ga_seqlock *lock)
+{
+    // Only the writer changes the sequence, so no read-modify-write is needed
+    unsigned int sequence = atomic_load_explicit(&lock->sequence, memory_order_relaxed);
+    atomic_store_explicit(&lock->sequence, sequence + 1, memory_order_relaxed);
+    // Keeps the data stores below from moving above the odd sequence
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void ga_seqlock_write_end(ga_seqlock *lock)
+{
+    unsigned int sequence = atomic_load_explicit(&lock->sequence, memory_order_relaxed);
+    atomic_store_explicit(&lock->sequence, sequence + 1, memory_order_release);
+}
+
+static inline void ga_seqlock_write(ga_seqlock *lock, void *dst, const void *src, size_t size)
+{
+    ga_seqlock_write_begin(lock);
+    ga_seqlock_store(dst, src, size);
+    ga_seqlock_write_end(lock);
+}
+
+// Returns the (even) sequence of the snapshot in dst, or an odd number if it gave up
+static inline unsigned int ga_seqlock_read_sequence(atomic_uint *sequence, void *dst, const void *src, size_t size, unsigned int retries)
+{
+    for (;;) {
+        unsigned int before = atomic_load_explicit(sequence, memory_order_acquire);
+        if (!(before & 1)) {
+            ga_seqlock_load(dst, src, size);
+            // Keeps the data loads above from moving below the second sequence load
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(sequence, memory_order_relaxed) == before) return before;
+        }
+        if (!retries) return 1;
+        if (retries != GA_SEQLOCK_RETRY_FOREVER) retries--;
+        ga_cpu_relax();
+    }
+}
+
+static inline bool ga_seqlock_read(ga_seqlock *lock, void *dst, const void *src, size_t size, unsigned int retries)
+{
+    return !(ga_seqlock_read_sequence(&lock->sequence, dst, src, size, retries) & 1);
+}
+
+static inline atomic_uint* ga_seqlock_array_bank(ga_seqlock_array *array, size_t bank)
+{
+    return array->data + bank * array->stride;
+}
+
+static inline void ga_seqlock_array_write(ga_seqlock_array *array, size_t bank, const void *data)
+{
+    ga_seqlock *lock = (ga_seqlock*)ga_seqlock_array_bank(array, bank);
+    ga_seqlock_write(lock, (void*)lock + GA_SEQLOCK_BANK_HEADER, data, array->bank_size);
+}
+
+static inline bool ga_seqlock_array_read(ga_seqlock_array *array, size_t bank, void *data, unsigned int retries, unsigned int *sequence)
+{
+    atomic_uint *bank_sequence = ga_seqlock_array_bank(array, bank);
+    unsigned int read = ga_seqlock_read_sequence(bank_sequence, data, (void*)bank_sequence + GA_SEQLOCK_BANK_HEADER, array->bank_size, retries);
+    if (read & 1) return false;
+    if (sequence) *sequence = read;
+    return true;
+}
+
+static inline unsigned int ga_seqlock_array_sequence(ga_seqlock_array *array, size_t bank)
+{
+    return atomic_load_explicit(ga_seqlock_array_bank(array, bank), memory_order_acquire);
+}
+
+#endif
@@ -0,0 +1,149 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+#ifndef _GA_STREAM
+#define _GA_STREAM
+
+/*****************************************************************
+                         DISK STREAMING
+
+  Plays audio files from disk without loading them into memory,
+  and without the audio thread ever touching the file system.
+
+  A ga_stream_file is opened on a non-realtime thread. A decoder
+  is chosen by probing the start of the file (WAV is built in;
+  ga_stream_file_open_raw opens headerless PCM), and the first
+  head_frames are decoded into a head cache in locked memory, so
+  that playback can start, and seek back to the start, instantly.
+
+  Files are read by mapping them into memory, with madvise hints
+  ahead of the read position, or with GA_STREAM_PREAD by reading
+  large aligned chunks with pread, with posix_fadvise hints.
+
+  A ga_streamer runs a prefetch thread, which keeps a ring buffer
+  of read_ahead_frames decoded frames ahead of the play position
+  of every ga_stream_voice, checking every interval_ms. A voice
+  plays one file; any number of voices can play the same file.
+
+  The audio thread calls ga_stream_voice_read to get the next
+  frames (interleaved floats, with the file's channel count), and
+  ga_stream_voice_seek to move the play position. Seeks within the
+  head cache are served immediately; other seeks play silence
+  until the prefetch thread has caught up. If the disk can't keep
+  up, the missing frames are silent, and the underrun is counted
+  (ga_stream_voice_underruns). Past the end of the file, voices
+  output silence without counting underruns.
+
+  Voices are created and destroyed on non-realtime threads; a
+  file must outlive its voices.
+
+  Decoders for other formats (e.g. the OGG/Vorbis and MP3 import
+  options) implement ga_stream_decoder and are added with
+  ga_stream_register_decoder. A decoder reads its file through
+  ga_stream_source_read, which takes care of the I/O strategy,
+  and must support reading from any frame. It is only ever called
+  from one thread at a time.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <ga/util.h>
+#include "config.h"
+
+#define GA_STREAM_CHUNK_FRAMES  4096    //  Frames decoded at a time by the prefetch thread
+#define GA_STREAM_PROBE_SIZE    64      //  Bytes passed to the decoder probe functions
+#define GA_STREAM_MAX_DECODERS  16
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_stream_file ga_stream_file;
+typedef struct ga_stream_source ga_stream_source;
+typedef struct ga_streamer ga_streamer;
+typedef struct ga_stream_voice ga_stream_voice;
+
+typedef enum {
+    GA_STREAM_DEFAULT   = 0,
+    GA_STREAM_PREAD     = 1 << 0    //  Use pread instead of mapping the file
+} ga_stream_flags;
+
+typedef enum {
+    GA_SAMPLE_INT16,
+    GA_SAMPLE_INT24,
+    GA_SAMPLE_INT32,
+    GA_SAMPLE_FLOAT32
+} ga_sample_format;
+
+typedef struct ga_stream_format {
+    unsigned int    channels;
+    double          sample_rate;
+    uint64_t        frames;
+} ga_stream_format;
+
+typedef struct ga_stream_decoder {
+    const char  *name;
+    bool        (*probe)(const void *header, size_t size);
+    void*       (*open)(ga_stream_source *source, ga_stream_format *format);
+    size_t      (*read)(void *decoder, uint64_t frame, float *output, size_t frames);
+    void        (*close)(void *decoder);
+} ga_stream_decoder;
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_stream_file* ga_stream_file_open(const char *path, size_t head_frames, ga_stream_flags flags);
+ga_stream_file* ga_stream_file_open_raw(const char *path, size_t head_frames, ga_stream_flags flags,
+                                        unsigned int channels, double sample_rate, ga_sample_format format, uint64_t offset);
+void ga_stream_file_close(ga_stream_file *file);
+void ga_stream_file_get_format(ga_stream_file *file, ga_stream_format *format);
+
+ga_streamer* ga_streamer_create(size_t read_ahead_frames, unsigned int interval_ms);
+void ga_streamer_destroy(ga_streamer *streamer);
+
+ga_stream_voice* ga_stream_voice_create(ga_streamer *streamer, ga_stream_file *file);
+void ga_stream_voice_destroy(ga_stream_voice *voice);
+size_t ga_stream_voice_read(ga_stream_voice *voice, float *output, size_t frames);
+void ga_stream_voice_seek(ga_stream_voice *voice, uint64_t frame);
+uint64_t ga_stream_voice_position(ga_stream_voice *voice);
+bool ga_stream_voice_finished(ga_stream_voice *voice);
+uint64_t ga_stream_voice_underruns(ga_stream_voice *voice);
+
+// For decoders
+void ga_stream_register_decoder(const ga_stream_decoder *decoder);
+size_t ga_stream_source_read(ga_stream_source *source, uint64_t offset, size_t size, void *data);
+uint64_t ga_stream_source_size(ga_stream_source *source);
+
+// "Private" stuff below
+
+extern const ga_stream_decoder ga_stream_wav_decoder;
+const ga_stream_decoder* ga_stream_raw_decoder();
+void* ga_stream_raw_open(ga_stream_source *source, unsigned int channels, double sample_rate,
+                         ga_sample_format format, uint64_t offset, ga_stream_format *stream_format);
+ga_stream_source* ga_stream_source_open(const char *path, ga_stream_flags flags);
+void ga_stream_source_close(ga_stream_source *source);
+
+#endif
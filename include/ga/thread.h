@@ -30,19 +30,88 @@
  *****************************************************************
                         THREAD WRAPPER
 
+  ga_thread_create_with_attr creates a thread with the attributes
+  in a ga_thread_attr (start from GA_THREAD_ATTR_DEFAULT):
+
+    name
+      Thread name, also set as the OS thread name where supported
+      (truncated to 15 characters on Linux)
+
+    policy, priority
+      GA_THREAD_POLICY_FIFO or GA_THREAD_POLICY_RR give the thread
+      a realtime priority (1-99). If that is not permitted (e.g.
+      no CAP_SYS_NICE or RLIMIT_RTPRIO on Linux) or the priority
+      is out of range, the thread is created with the default
+      policy instead, and a warning is printed.
+      GA_THREAD_POLICY_IDLE is for background work that should
+      only run when nothing else wants the CPU (SCHED_IDLE on
+      Linux, the lowest default priority on Mac OS X), and
+      ignores the priority.
+      ga_thread_get_policy and ga_thread_get_priority return what
+      the thread actually got.
+
+    affinity
+      CPUs the thread may run on (empty means all). Ignored on
+      platforms without thread affinity (Mac OS X), and, with a
+      warning, if none of the CPUs is available.
+
+    stack_size, prefault_stack
+      Stack size in bytes (0 means the default), and whether to
+      touch the whole stack before the thread function runs, so
+      that it never page faults on stack growth.
 
  *****************************************************************
  *****************************************************************/
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <ga/util.h>
 
+/*
+ *  TYPES
+ */
+
 typedef struct ga_thread ga_thread;
 
 typedef void* (* ga_thread_func)(void*);
 
+#define GA_MAX_CPUS 1024
+
+typedef struct ga_cpu_set {
+    uint64_t bits[GA_MAX_CPUS / 64];
+} ga_cpu_set;
+
+typedef enum ga_thread_policy {
+    GA_THREAD_POLICY_DEFAULT,
+    GA_THREAD_POLICY_FIFO,
+    GA_THREAD_POLICY_RR,
+    GA_THREAD_POLICY_IDLE
+} ga_thread_policy;
+
+typedef struct ga_thread_attr {
+    const char          *name;
+    ga_thread_policy    policy;
+    int                 priority;
+    ga_cpu_set          affinity;
+    size_t              stack_size;
+    bool                prefault_stack;
+} ga_thread_attr;
+
+#define GA_THREAD_ATTR_DEFAULT ((ga_thread_attr) { NULL, GA_THREAD_POLICY_DEFAULT, 0, {{0}}, 0, false })
+
+/*
+ *  FUNCTIONS
+ */
+
+void ga_thread_initialize();
+void ga_thread_terminate();
+
 ga_thread* ga_thread_create(ga_thread_func func, void* data);
 ga_thread* ga_thread_create_named(ga_thread_func func, void* data, const char *name);
+ga_thread* ga_thread_create_with_attr(ga_thread_func func, void* data, const ga_thread_attr *attr);
+
+ga_thread_policy ga_thread_get_policy(ga_thread *thread);
+int ga_thread_get_priority(ga_thread *thread);
 
 void ga_thread_sleep(unsigned int ms);
 void* ga_thread_join(ga_thread *thread);
@@ -50,4 +119,27 @@ void ga_thread_detach(ga_thread *thread);
 bool ga_thread_is_main(ga_thread *thread);
 bool ga_thread_is_current(ga_thread *thread);
 
+static inline void ga_cpu_set_clear(ga_cpu_set *set)
+{
+    for (int i = 0; i < GA_MAX_CPUS / 64; i++) set->bits[i] = 0;
+}
+
+static inline void ga_cpu_set_add(ga_cpu_set *set, int cpu)
+{
+    set->bits[cpu / 64] |= 1ull << (cpu % 64);
+}
+
+static inline bool ga_cpu_set_has(const ga_cpu_set *set, int cpu)
+{
+    return (set->bits[cpu / 64] >> (cpu % 64)) & 1;
+}
+
+static inline bool ga_cpu_set_is_empty(const ga_cpu_set *set)
+{
+    for (int i = 0; i < GA_MAX_CPUS / 64; i++) {
+        if (set->bits[i]) return false;
+    }
+    return true;
+}
+
 #endif
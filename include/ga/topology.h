@@ -0,0 +1,103 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+
+#ifndef _GA_TOPOLOGY
+#define _GA_TOPOLOGY
+
+/*****************************************************************
+
+                        CPU TOPOLOGY
+
+  Discovers which logical CPUs share a physical core (SMT
+  siblings), a package and a last level cache, by reading
+  /sys/devices/system/cpu. Elsewhere, every CPU is treated as a
+  separate core sharing one cache.
+
+  ga_topology_place fills in cpu sets for a group of threads
+  according to a placement policy, to be used as the affinity of
+  ga_thread_attr:
+
+    ga_topology *topology = ga_topology_create();
+    ga_cpu_set sets[4];
+    ga_topology_place(topology, GA_PLACEMENT_CORES_SAME_LLC, 4, sets);
+    ga_thread_attr attr = GA_THREAD_ATTR_DEFAULT;
+    attr.affinity = sets[0];
+    ...
+
+  The core policies pin each thread to one logical CPU on its own
+  physical core, leaving the SMT siblings of those CPUs unused by
+  the group. The first core (usually handling most interrupts) is
+  avoided when there are enough cores. If there are fewer cores
+  than threads, placement wraps around; the return value is the
+  number of threads that got a core of their own.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <ga/util.h>
+#include <ga/thread.h>
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_topology ga_topology;
+
+typedef struct ga_cpu_info {
+    int cpu;                    //  Logical CPU number
+    int package;
+    int core;                   //  Index of the physical core, from 0
+    int llc;                    //  Index of the last level cache, from 0
+    int smt_index;              //  Position among the SMT siblings of the core
+} ga_cpu_info;
+
+typedef enum ga_placement {
+    GA_PLACEMENT_ANY,           //  No affinity
+    GA_PLACEMENT_CORES,         //  One physical core per thread, spreading over caches if needed
+    GA_PLACEMENT_CORES_SAME_LLC //  One physical core per thread, all sharing the largest LLC
+} ga_placement;
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_topology* ga_topology_create();
+void ga_topology_destroy(ga_topology *topology);
+
+int ga_topology_cpu_count(ga_topology *topology);
+int ga_topology_core_count(ga_topology *topology);
+int ga_topology_package_count(ga_topology *topology);
+int ga_topology_llc_count(ga_topology *topology);
+const ga_cpu_info* ga_topology_cpu(ga_topology *topology, int index);
+
+void ga_topology_core_cpus(ga_topology *topology, int core, ga_cpu_set *set);
+void ga_topology_llc_cpus(ga_topology *topology, int llc, ga_cpu_set *set);
+
+int ga_topology_place(ga_topology *topology, ga_placement placement, unsigned int count, ga_cpu_set *sets);
+
+void ga_topology_print(ga_topology *topology);
+
+#endif
@@ -0,0 +1,174 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+
+#ifndef _GA_TRACE
+#define _GA_TRACE
+
+/*****************************************************************
+
+                        TRACE RECORDER
+
+  Records what each thread is doing, to find out why a callback
+  overran. Traces are written as Chrome trace event JSON, which can
+  be opened in chrome://tracing or Perfetto.
+
+    GA_TRACE_BEGIN("mix");
+    ...
+    GA_TRACE_END("mix");
+    GA_TRACE_INSTANT("xrun");
+    GA_TRACE_COUNTER("voices", count);
+    GA_TRACE_SCOPE("process");      // Ends when the scope is left
+
+  Names must be string literals (only the pointer is recorded).
+
+  The macros are compiled out unless the build is configured with
+  ENABLE_TRACE (GA_TRACE in config.h). When enabled, they do
+  nothing until ga_trace_start is called; a record is a timestamp
+  (the CPU cycle counter, where available) and a 32 byte write to
+  the ring buffer of the calling thread. If that buffer is full, the
+  record is dropped and counted.
+
+  Each thread gets its own ring buffer the first time it records
+  something, which allocates; realtime threads should call
+  ga_trace_register_thread before entering a realtime section. The
+  name given there is shown in the trace. Buffers of threads that
+  have exited are reused.
+
+  ga_trace_start starts a collector thread, which drains the
+  buffers every interval_ms and writes the events to a file.
+  ga_trace_stop stops it and completes the file.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <ga/util.h>
+#include <ga/util/time.h>
+#include <ga/ring_buffer.h>
+#include "config.h"
+
+/*
+ *  TYPES
+ */
+
+typedef enum ga_trace_event_type {
+    GA_TRACE_EVENT_BEGIN,
+    GA_TRACE_EVENT_END,
+    GA_TRACE_EVENT_INSTANT,
+    GA_TRACE_EVENT_COUNTER
+} ga_trace_event_type;
+
+#define GA_TRACE_BUFFER_EVENTS 16384
+
+/*
+ *  FUNCTIONS
+ */
+
+bool ga_trace_start(const char *path, unsigned int interval_ms);
+void ga_trace_stop();
+bool ga_trace_is_running();
+uint64_t ga_trace_dropped();
+
+void ga_trace_register_thread(const char *name);
+
+#if GA_TRACE
+#define GA_TRACE_BEGIN(name)            ga_trace_record(GA_TRACE_EVENT_BEGIN, name, 0)
+#define GA_TRACE_END(name)              ga_trace_record(GA_TRACE_EVENT_END, name, 0)
+#define GA_TRACE_INSTANT(name)          ga_trace_record(GA_TRACE_EVENT_INSTANT, name, 0)
+#define GA_TRACE_COUNTER(name, value)   ga_trace_record(GA_TRACE_EVENT_COUNTER, name, value)
+#define GA_TRACE_SCOPE(name)            GA_TRACE_SCOPE_(name, __COUNTER__)
+#else
+#define GA_TRACE_BEGIN(name)            do {} while (0)
+#define GA_TRACE_END(name)              do {} while (0)
+#define GA_TRACE_INSTANT(name)          do {} while (0)
+#define GA_TRACE_COUNTER(name, value)   do {} while (0)
+#define GA_TRACE_SCOPE(name)            do {} while (0)
+#endif
+
+// "Private" stuff below
+// (Must be present in the header file to enable inlining)
+
+typedef struct ga_trace_event {
+    uint64_t            time;           //  From ga_trace_now
+    const char          *name;
+    int64_t             value;
+    uint32_t            type;
+    uint32_t            reserved;
+} ga_trace_event;
+
+typedef struct ga_trace_buffer ga_trace_buffer;
+
+struct ga_trace_buffer {
+    ga_ring_buffer      *ring;
+    atomic_ullong       dropped;        //  Written by the owning thread only
+    atomic_uint         used;           //  Owned by a live thread
+    atomic_uint         generation;     //  Incremented when the buffer changes hands
+    const char *_Atomic name;
+    unsigned int        id;
+    unsigned int        named_generation;   //  Generation whose name was written, collector only
+    ga_trace_buffer     *next;
+};
+
+extern atomic_uint ga_trace_enabled;
+extern _Thread_local ga_trace_buffer *ga_trace_local;
+
+ga_trace_buffer* ga_trace_local_buffer();
+
+static inline uint64_t ga_trace_now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (ticks));
+    return ticks;
+#else
+    return ga_now_ns();
+#endif
+}
+
+static inline void ga_trace_record(ga_trace_event_type type, const char *name, int64_t value)
+{
+    if (!atomic_load_explicit(&ga_trace_enabled, memory_order_relaxed)) return;
+    ga_trace_buffer *buffer = ga_trace_local ? ga_trace_local : ga_trace_local_buffer();
+    ga_trace_event event = { ga_trace_now(), name, value, type, 0 };
+    if (!ga_ring_buffer_write_atomic(buffer->ring, sizeof(event), &event)) {
+        atomic_store_explicit(&buffer->dropped, atomic_load_explicit(&buffer->dropped, memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+}
+
+static inline void ga_trace_scope_end(const char **name)
+{
+    ga_trace_record(GA_TRACE_EVENT_END, *name, 0);
+}
+
+#define GA_TRACE_SCOPE_CAT(a, b)    a ## b
+#define GA_TRACE_SCOPE_NAME(n)      GA_TRACE_SCOPE_CAT(ga_trace_scope_, n)
+#define GA_TRACE_SCOPE_(name, n) \
+    const char *GA_TRACE_SCOPE_NAME(n) __attribute__((cleanup(ga_trace_scope_end))) = (name); \
+    ga_trace_record(GA_TRACE_EVENT_BEGIN, GA_TRACE_SCOPE_NAME(n), 0)
+
+#endif
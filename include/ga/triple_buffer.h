@@ -0,0 +1,138 @@
+/*
+  
+  Copyright (c) 2017 Erik Ronström
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+#ifndef _GA_TRIPLE_BUFFER
+#define _GA_TRIPLE_BUFFER
+
+/*****************************************************************
+                    LOCK FREE TRIPLE BUFFER
+
+  Publishes snapshots of a fixed size block (a parameter set,
+  a bank of meters) from a single writer thread to a single
+  reader thread. Unlike a queue, the reader only ever sees the
+  latest complete snapshot; states it never got to are skipped.
+
+  The three slots are allocated in place when the buffer is
+  created. After that, neither side allocates or blocks, and each
+  publish or fetch is a single atomic exchange.
+
+  The writer fills the slot returned by ga_triple_buffer_write_slot
+  and then calls ga_triple_buffer_publish. The write slot is not
+  the previous snapshot, so it must be written in full (or kept
+  in sync by the writer). ga_triple_buffer_write copies a whole
+  snapshot and publishes it.
+
+  The reader calls ga_triple_buffer_fetch, which returns true if a
+  newer snapshot has been published since the last fetch, and then
+  reads it from ga_triple_buffer_read_slot. The read slot stays
+  valid and unchanged until the next fetch. ga_triple_buffer_read
+  does both, returning the latest snapshot.
+
+  Before the first publish, the reader sees a zeroed snapshot.
+
+  ga_triple_buffer_create_with_flags takes ga_mem_flags (see
+  ga/alloc.h) for the slot memory. Pass GA_MEM_REALTIME for buffers
+  that are used from realtime threads.
+
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <ga/util.h>
+#include <ga/alloc.h>
+#include "config.h"
+
+/*
+ *  TYPES
+ */
+
+typedef struct ga_triple_buffer ga_triple_buffer;
+
+/*
+ *  FUNCTIONS
+ */
+
+ga_triple_buffer* ga_triple_buffer_create(size_t size);
+ga_triple_buffer* ga_triple_buffer_create_with_flags(size_t size, ga_mem_flags flags);
+void ga_triple_buffer_destroy(ga_triple_buffer *buffer);
+size_t ga_triple_buffer_size(ga_triple_buffer *buffer);
+
+// Writer
+static inline void* ga_triple_buffer_write_slot(ga_triple_buffer *buffer);
+static inline void ga_triple_buffer_publish(ga_triple_buffer *buffer);
+void ga_triple_buffer_write(ga_triple_buffer *buffer, const void *data);
+
+// Reader
+static inline bool ga_triple_buffer_fetch(ga_triple_buffer *buffer);
+static inline void* ga_triple_buffer_read_slot(ga_triple_buffer *buffer);
+static inline void* ga_triple_buffer_read(ga_triple_buffer *buffer);
+
+// "Private" stuff below
+// (Must be present in the header file to enable inlining)
+
+#define GA_TRIPLE_BUFFER_INDEX  3u
+#define GA_TRIPLE_BUFFER_FRESH  4u      //  Set when the middle slot holds an unread snapshot
+
+struct ga_triple_buffer {
+    void            *data;              //  The three slots (immutable)
+    size_t          size;               //  Snapshot size (immutable)
+    size_t          slot_size;          //  Size rounded up to a cache line (immutable)
+    // Each of these on its own cache line
+    atomic_uint     middle __attribute__((aligned(CACHELINE_SIZE)));    //  Index of the slot in between, and the fresh flag
+    unsigned int    back __attribute__((aligned(CACHELINE_SIZE)));      //  Index of the write slot, owned by the writer
+    unsigned int    front __attribute__((aligned(CACHELINE_SIZE)));     //  Index of the read slot, owned by the reader
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+static inline void* ga_triple_buffer_write_slot(ga_triple_buffer *buffer)
+{
+    return buffer->data + buffer->back * buffer->slot_size;
+}
+
+static inline void ga_triple_buffer_publish(ga_triple_buffer *buffer)
+{
+    // Release the write slot, and take back whichever slot the reader is not using
+    unsigned int old = atomic_exchange_explicit(&buffer->middle, buffer->back | GA_TRIPLE_BUFFER_FRESH, memory_order_acq_rel);
+    buffer->back = old & GA_TRIPLE_BUFFER_INDEX;
+}
+
+static inline bool ga_triple_buffer_fetch(ga_triple_buffer *buffer)
+{
+    if (!(atomic_load_explicit(&buffer->middle, memory_order_relaxed) & GA_TRIPLE_BUFFER_FRESH)) return false;
+    unsigned int old = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+    buffer->front = old & GA_TRIPLE_BUFFER_INDEX;
+    return true;
+}
+
+static inline void* ga_triple_buffer_read_slot(ga_triple_buffer *buffer)
+{
+    return buffer->data + buffer->front * buffer->slot_size;
+}
+
+static inline void* ga_triple_buffer_read(ga_triple_buffer *buffer)
+{
+    ga_triple_buffer_fetch(buffer);
+    return ga_triple_buffer_read_slot(buffer);
+}
+
+#endif
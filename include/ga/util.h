@@ -3,6 +3,7 @@
 
 #include "ga/util/vararg.h"
 #include "ga/util/minmax.h"
+#include "ga/util/cpu.h"
 
 #if GA_DEBUG
 #define fatal_error0() _fatal_error(NULL, __func__, __FILE__, __LINE__);
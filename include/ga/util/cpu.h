@@ -0,0 +1,15 @@
+
+#ifndef _GA_UTIL_CPU
+#define _GA_UTIL_CPU
+
+// Hint to the CPU that we're in a spin loop
+static inline void ga_cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef _GA_UTIL_TIME
+#define _GA_UTIL_TIME
+
+#include <stdint.h>
+#include <time.h>
+
+// Monotonic time in nanoseconds, for measuring intervals
+static inline uint64_t ga_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#endif
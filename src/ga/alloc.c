@@ -3,110 +3,470 @@
 // #include <config.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
 #include "ga/util.h"
-#if GA_DEBUG
-#include <stdatomic.h>
+#include "ga/realtime.h"
+#include "ga/log.h"
+#if !WINDOWS
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
 #endif
 
-#if GA_DEBUG
-static atomic_size_t gBytesCurAlloc   = 0;
-static atomic_size_t gBytesMaxAlloc   = 0;
-static atomic_size_t gBytesTotAlloc   = 0;
-static atomic_size_t gRegionsCurAlloc = 0;
-static atomic_size_t gRegionsMaxAlloc = 0;
-static atomic_size_t gRegionsTotAlloc = 0;
-#else
-static size_t gBytesTotAlloc   = 0;
-static size_t gRegionsCurAlloc = 0;
-#endif
+// The alignment malloc guarantees
+#define MALLOC_ALIGNMENT _Alignof(max_align_t)
+
+#define IS_POWER_OF_TWO(x) ((x) && !((x) & ((x) - 1)))
+
+// Every block is preceded by a header. The header is placed immediately
+// before the (aligned) user pointer, and is padded to MALLOC_ALIGNMENT
+// so that plain allocations keep malloc's alignment.
+typedef struct alloc_header {
+    _Alignas(max_align_t) size_t size;      // Requested size
+    uint32_t offset;                        // Distance from the raw pointer to the user pointer
+    uint16_t tag;                           // ga_alloc_tag
+    uint16_t flags;                         // BLOCK_* flags below
+} alloc_header;
+
+#define BLOCK_ALIGNED   1                   // Allocated with a larger alignment than malloc's (can't be realloc'd)
+#define BLOCK_LOCKED    2                   // Pages are mlocked, and must be unlocked on free
+
+#define HUGE_PAGE_SIZE  (2 * 1024 * 1024)
+
+// Statistics shard. Each thread gets its own, and is the only one
+// writing to it, so the counters are updated with plain relaxed
+// loads and stores. Readers sum all shards. Counters for current
+// values may wrap in a single shard (when a block is freed by
+// another thread than the one allocating it), but the sum is correct.
+typedef struct alloc_shard alloc_shard;
+struct alloc_shard {
+    _Alignas(CACHELINE_SIZE) atomic_size_t bytes_cur;
+    atomic_size_t bytes_tot;
+    atomic_size_t regions_cur;
+    atomic_size_t regions_tot;
+    atomic_size_t bytes_peak;               // High-water marks of bytes_cur and regions_cur
+    atomic_size_t regions_peak;
+    atomic_size_t tag_bytes[GA_ALLOC_TAG_COUNT];
+    atomic_size_t tag_regions[GA_ALLOC_TAG_COUNT];
+    atomic_size_t size_classes[GA_ALLOC_SIZE_CLASSES];
+    atomic_uint used;                       // Owned by a running thread
+    alloc_shard *next;
+};
+
+// Shards are never freed. A thread that exits releases its shard,
+// counts and all, which is exactly what the totals need, and the
+// next new thread takes it over instead of allocating another.
+static _Atomic(alloc_shard*) gShards = NULL;
+static _Thread_local alloc_shard *tShard = NULL;
+static pthread_key_t gExitKey;
+static pthread_once_t gExitKeyOnce = PTHREAD_ONCE_INIT;
+
+// Flags used for GA_MEM_REALTIME allocations
+static _Atomic(ga_mem_flags) gRealtimeFlags = GA_MEM_PREFAULT | GA_MEM_LOCK;
+
+// Why the last mlock failed (NULL if it didn't)
+static _Atomic(const char*) gLockError = NULL;
+
+static const char *gTagNames[GA_ALLOC_TAG_COUNT] = {
+    "default",
+    "queue",
+    "ring_buffer",
+    "thread",
+    "string"
+};
 
 // static fa_error_severity_t  gLogLevel     = info;
 
+// -----------------------------------------------------------------------------
+
+// Frees from later thread exit destructors get a shard again, and release it again
+static void release_shard(void *data)
+{
+    alloc_shard *shard = data;
+    tShard = NULL;
+    atomic_store_explicit(&shard->used, 0, memory_order_release);
+}
+
+static void create_exit_key()
+{
+    pthread_key_create(&gExitKey, release_shard);
+}
 
+static alloc_shard* new_shard()
+{
+    pthread_once(&gExitKeyOnce, create_exit_key);
 
+    alloc_shard *shard = NULL;
+    // Take over the shard of an exited thread
+    for (alloc_shard *s = atomic_load_explicit(&gShards, memory_order_acquire); s; s = s->next) {
+        unsigned int expected = 0;
+        if (!atomic_load_explicit(&s->used, memory_order_relaxed)
+                && atomic_compare_exchange_strong(&s->used, &expected, 1)) {
+            shard = s;
+            break;
+        }
+    }
+    if (!shard) {
+        // Not using ga_malloc, since that would recurse back here
+        shard = aligned_alloc(CACHELINE_SIZE, sizeof(alloc_shard));
+        if (!shard) fatal_error("Could not allocate allocation statistics");
+        memset(shard, 0, sizeof(alloc_shard));
+        atomic_init(&shard->used, 1);
 
-void* ga_malloc(size_t size)
+        alloc_shard *head = atomic_load_explicit(&gShards, memory_order_relaxed);
+        do {
+            shard->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&gShards, &head, shard, memory_order_release, memory_order_relaxed));
+    }
+    pthread_setspecific(gExitKey, shard);
+    return shard;
+}
+
+static inline alloc_shard* get_shard()
+{
+    alloc_shard *shard = tShard;
+    if (!shard) shard = tShard = new_shard();
+    return shard;
+}
+
+// Owner-only update, no read-modify-write needed
+static inline void shard_add(atomic_size_t *counter, size_t value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+// Owner-only too. The current value is compared as signed, since it
+// goes below zero in a shard that frees more than it allocates.
+static inline void shard_peak(atomic_size_t *peak, size_t value)
+{
+    if ((ptrdiff_t)value > (ptrdiff_t)atomic_load_explicit(peak, memory_order_relaxed)) {
+        atomic_store_explicit(peak, value, memory_order_relaxed);
+    }
+}
+
+static inline unsigned int size_class(size_t size)
+{
+    unsigned int c = size ? (sizeof(unsigned long long) * 8) - __builtin_clzll(size) : 0;
+    return c < GA_ALLOC_SIZE_CLASSES ? c : GA_ALLOC_SIZE_CLASSES - 1;
+}
+
+static inline void count_alloc(size_t size, ga_alloc_tag tag)
+{
+    alloc_shard *shard = get_shard();
+    shard_add(&shard->bytes_cur, size);
+    shard_add(&shard->bytes_tot, size);
+    shard_add(&shard->regions_cur, 1);
+    shard_add(&shard->regions_tot, 1);
+    shard_add(&shard->tag_bytes[tag], size);
+    shard_add(&shard->tag_regions[tag], 1);
+    shard_add(&shard->size_classes[size_class(size)], 1);
+    shard_peak(&shard->bytes_peak, atomic_load_explicit(&shard->bytes_cur, memory_order_relaxed));
+    shard_peak(&shard->regions_peak, atomic_load_explicit(&shard->regions_cur, memory_order_relaxed));
+}
+
+static inline void count_free(size_t size, ga_alloc_tag tag)
 {
+    alloc_shard *shard = get_shard();
+    shard_add(&shard->bytes_cur, -size);
+    shard_add(&shard->regions_cur, -1);
+    shard_add(&shard->tag_bytes[tag], -size);
+    shard_add(&shard->tag_regions[tag], -1);
+}
+
+static inline alloc_header* header_of(void *ptr)
+{
+    return (alloc_header*)ptr - 1;
+}
+
+static void* alloc(size_t alignment, size_t size, ga_alloc_tag tag, bool zero)
+{
+    assert(tag < GA_ALLOC_TAG_COUNT);
 #if GA_DEBUG
     if (size == 0) {
         printf("Warning: ga_malloc(0), returning NULL\n");
         return NULL;
     }
     if (size >= 2147483648) fatal_error("Request for allocation of %zu bytes of memory, limit is 2 GB", size);
-    void *rawptr = malloc(size+sizeof(size_t));
+#endif
+    size_t extra = sizeof(alloc_header) + (alignment > MALLOC_ALIGNMENT ? alignment - MALLOC_ALIGNMENT : 0);
+    if (size > SIZE_MAX - extra) return NULL;
+    void *rawptr = zero ? calloc(1, size + extra) : malloc(size + extra);
+#if GA_DEBUG
     if (!rawptr) fatal_error("Could not allocate %zu bytes of memory", size);
-    atomic_fetch_add(&gBytesTotAlloc, size);
-    atomic_fetch_add(&gBytesCurAlloc, size);
-    if (gBytesCurAlloc > gBytesMaxAlloc) gBytesMaxAlloc = gBytesCurAlloc; // Don't care with atomic for max
-    atomic_fetch_add(&gRegionsTotAlloc, 1);
-    atomic_fetch_add(&gRegionsCurAlloc, 1);
-    if (gRegionsCurAlloc > gRegionsMaxAlloc) gRegionsMaxAlloc = gRegionsCurAlloc;
-    *(size_t*)rawptr = size;
-    return rawptr+sizeof(size_t);
 #else
-    gBytesTotAlloc += size;
-    gRegionsCurAlloc += 1;
-    return malloc(size);
+    if (!rawptr) return NULL;
 #endif
+    uintptr_t user = ((uintptr_t)rawptr + sizeof(alloc_header) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    void *ptr = (void*)user;
+    header_of(ptr)->size = size;
+    header_of(ptr)->offset = user - (uintptr_t)rawptr;
+    header_of(ptr)->tag = tag;
+    header_of(ptr)->flags = alignment > MALLOC_ALIGNMENT ? BLOCK_ALIGNED : 0;
+    count_alloc(size, tag);
+    return ptr;
 }
 
-void* ga_calloc(size_t count, size_t size)
+// -----------------------------------------------------------------------------
+
+static inline size_t fix_alignment(size_t alignment)
 {
+    assert(IS_POWER_OF_TWO(alignment) && "Alignment must be a power of two");
+    return alignment > MALLOC_ALIGNMENT ? alignment : MALLOC_ALIGNMENT;
+}
+
+// count * size, failing like an allocation does if it overflows
+static inline bool array_size(size_t count, size_t size, size_t *total)
+{
+    if (!__builtin_mul_overflow(count, size, total)) return true;
 #if GA_DEBUG
-    void* ptr = ga_malloc(count * size);
-    memset(ptr, 0, count * size);
-    return ptr;
-#else
-    gBytesTotAlloc += size;
-    gRegionsCurAlloc += 1;
-    return calloc(count, size);
+    fatal_error("Request for allocation of %zu * %zu bytes of memory overflows", count, size);
 #endif
+    return false;
+}
+
+void* ga_malloc(size_t size)
+{
+    ga_realtime_check("ga_malloc");
+    return alloc(MALLOC_ALIGNMENT, size, GA_ALLOC_TAG_DEFAULT, false);
+}
+
+void* ga_calloc(size_t count, size_t size)
+{
+    ga_realtime_check("ga_calloc");
+    size_t total;
+    if (!array_size(count, size, &total)) return NULL;
+    return alloc(MALLOC_ALIGNMENT, total, GA_ALLOC_TAG_DEFAULT, true);
+}
+
+void* ga_malloc_tagged(size_t size, ga_alloc_tag tag)
+{
+    ga_realtime_check("ga_malloc");
+    return alloc(MALLOC_ALIGNMENT, size, tag, false);
+}
+
+void* ga_calloc_tagged(size_t count, size_t size, ga_alloc_tag tag)
+{
+    ga_realtime_check("ga_calloc");
+    size_t total;
+    if (!array_size(count, size, &total)) return NULL;
+    return alloc(MALLOC_ALIGNMENT, total, tag, true);
+}
+
+void* ga_malloc_aligned(size_t alignment, size_t size)
+{
+    ga_realtime_check("ga_malloc_aligned");
+    return alloc(fix_alignment(alignment), size, GA_ALLOC_TAG_DEFAULT, false);
+}
+
+void* ga_calloc_aligned(size_t alignment, size_t count, size_t size)
+{
+    ga_realtime_check("ga_calloc_aligned");
+    size_t total;
+    if (!array_size(count, size, &total)) return NULL;
+    return alloc(fix_alignment(alignment), total, GA_ALLOC_TAG_DEFAULT, true);
+}
+
+void* ga_malloc_aligned_tagged(size_t alignment, size_t size, ga_alloc_tag tag)
+{
+    ga_realtime_check("ga_malloc_aligned");
+    return alloc(fix_alignment(alignment), size, tag, false);
+}
+
+void* ga_calloc_aligned_tagged(size_t alignment, size_t count, size_t size, ga_alloc_tag tag)
+{
+    ga_realtime_check("ga_calloc_aligned");
+    size_t total;
+    if (!array_size(count, size, &total)) return NULL;
+    return alloc(fix_alignment(alignment), total, tag, true);
 }
 
 void* ga_realloc(void *ptr, size_t size)
 {
+    ga_realtime_check("ga_realloc");
+    if (!ptr) return alloc(MALLOC_ALIGNMENT, size, GA_ALLOC_TAG_DEFAULT, false); // Like realloc(NULL, size)
+    assert(!(header_of(ptr)->flags & BLOCK_ALIGNED) && "Trying to realloc an aligned block");
+    size_t old_size = header_of(ptr)->size;
+    ga_alloc_tag tag = header_of(ptr)->tag;
+    void *rawptr = realloc(header_of(ptr), size + sizeof(alloc_header));
 #if GA_DEBUG
-    assert(ptr && "Trying to realloc NULL pointer");
-    void *rawptr = ptr - sizeof(size_t);
-    size_t old_size = *(size_t*)rawptr;
-    rawptr = realloc(rawptr, size + sizeof(size_t));
     if (!rawptr) fatal_error("Could not reallocate %zu bytes of memory", size);
-    atomic_fetch_add(&gBytesTotAlloc, size - old_size);
-    atomic_fetch_add(&gBytesCurAlloc, size - old_size);
-    if (gBytesCurAlloc > gBytesMaxAlloc) gBytesMaxAlloc = gBytesCurAlloc; // Don't care with atomic for max
-    *(size_t*)rawptr = size;
-    return rawptr+sizeof(size_t);
 #else
-    return realloc(ptr, size);
+    if (!rawptr) return NULL;
 #endif
+    count_free(old_size, tag);
+    count_alloc(size, tag);
+    ptr = (alloc_header*)rawptr + 1;
+    header_of(ptr)->size = size;
+    return ptr;
 }
 
 void ga_free(void *ptr)
 {
-#if GA_DEBUG
-    assert(ptr && "Trying to free NULL pointer");
-    void *rawptr = ptr - sizeof(size_t);
-    size_t size = *(size_t*)rawptr;
-    atomic_fetch_add(&gBytesCurAlloc, -size);
-    atomic_fetch_add(&gRegionsCurAlloc, -1);
-    free(rawptr);
-#else
-    gRegionsCurAlloc--;
-    free(ptr);
+    ga_realtime_check("ga_free");
+    if (!ptr) return; // Like free(NULL)
+    size_t size = header_of(ptr)->size;
+#if !WINDOWS
+    if (header_of(ptr)->flags & BLOCK_LOCKED) {
+        munlock(ptr, size);
+    }
 #endif
+    count_free(size, header_of(ptr)->tag);
+    free(ptr - header_of(ptr)->offset);
 }
 
+// -----------------------------------------------------------------------------
 
-void ga_print_alloc_info()
+static void lock_failed(int error)
 {
-#if GA_DEBUG
-    printf("Currently allocated:   %zu bytes, %zu regions\n", gBytesCurAlloc, gRegionsCurAlloc);
-    printf("Peak:                  %zu bytes, %zu regions\n",  gBytesMaxAlloc, gRegionsMaxAlloc);
-    printf("Total allocated:       %zu bytes, %zu regions\n", gBytesTotAlloc, gRegionsTotAlloc);
+#if !WINDOWS
+    const char *reason;
+    switch (error) {
+    case EPERM:
+        reason = "mlock not permitted (needs CAP_IPC_LOCK or a higher RLIMIT_MEMLOCK)";
+        break;
+    case ENOMEM:
+    case EAGAIN:
+        reason = "mlock limit reached (raise RLIMIT_MEMLOCK)";
+        break;
+    default:
+        reason = "mlock failed";
+        break;
+    }
+    // Only report the first failure of each kind
+    if (atomic_exchange(&gLockError, reason) != reason) {
+        ga_log_warning("%s, realtime memory will only be prefaulted", reason);
+    }
+#endif
+}
+
+static void* alloc_realtime(size_t size, ga_mem_flags flags, ga_alloc_tag tag, bool zero)
+{
+    if (flags & GA_MEM_REALTIME) flags = atomic_load_explicit(&gRealtimeFlags, memory_order_relaxed);
+    if (!(flags & (GA_MEM_PREFAULT | GA_MEM_LOCK | GA_MEM_HUGE_PAGES))) {
+        return alloc(MALLOC_ALIGNMENT, size, tag, zero);
+    }
+#if WINDOWS
+    return alloc(MALLOC_ALIGNMENT, size, tag, zero);
 #else
-    printf("%zu regions currently allocated, %zu bytes in total\n", gRegionsCurAlloc, gBytesTotAlloc);
-    printf("ga_print_alloc_info: not compiled with DEBUG\n");
+    // Give the block whole pages of its own, so that locking and
+    // unlocking it never affects a neighbour
+    static size_t page_size = 0;
+    if (!page_size) page_size = sysconf(_SC_PAGESIZE);
+    size_t alignment = page_size;
+#ifdef MADV_HUGEPAGE
+    if ((flags & GA_MEM_HUGE_PAGES) && size >= HUGE_PAGE_SIZE) alignment = HUGE_PAGE_SIZE;
+#endif
+    size_t rounded = (size + alignment - 1) & ~(alignment - 1);
+
+    void *ptr = alloc(alignment, rounded, tag, false);
+    if (!ptr) return NULL;
+#ifdef MADV_HUGEPAGE
+    if (alignment == HUGE_PAGE_SIZE) madvise(ptr, rounded, MADV_HUGEPAGE);
+#endif
+    // Touch every page, so that no page faults happen on first use
+    if (zero) {
+        memset(ptr, 0, rounded);
+    } else if (flags & (GA_MEM_PREFAULT | GA_MEM_LOCK)) {
+        for (size_t i = 0; i < rounded; i += page_size) {
+            ((volatile char*)ptr)[i] = 0;
+        }
+    }
+    if (flags & GA_MEM_LOCK) {
+        if (mlock(ptr, rounded) == 0) {
+            header_of(ptr)->flags |= BLOCK_LOCKED;
+        } else {
+            lock_failed(errno);
+        }
+    }
+    return ptr;
 #endif
 }
+
+void* ga_malloc_realtime(size_t size, ga_mem_flags flags, ga_alloc_tag tag)
+{
+    ga_realtime_check("ga_malloc_realtime");
+    return alloc_realtime(size, flags, tag, false);
+}
+
+void* ga_calloc_realtime(size_t count, size_t size, ga_mem_flags flags, ga_alloc_tag tag)
+{
+    ga_realtime_check("ga_calloc_realtime");
+    size_t total;
+    if (!array_size(count, size, &total)) return NULL;
+    return alloc_realtime(total, flags, tag, true);
+}
+
+void ga_alloc_set_realtime_flags(ga_mem_flags flags)
+{
+    assert(!(flags & GA_MEM_REALTIME) && "GA_MEM_REALTIME can't be a realtime flag");
+    atomic_store(&gRealtimeFlags, flags);
+}
+
+ga_mem_flags ga_alloc_get_realtime_flags()
+{
+    return atomic_load(&gRealtimeFlags);
+}
+
+bool ga_alloc_is_locked(void *ptr)
+{
+    return (header_of(ptr)->flags & BLOCK_LOCKED) != 0;
+}
+
+const char* ga_alloc_lock_error()
+{
+    return atomic_load(&gLockError);
+}
+
+// -----------------------------------------------------------------------------
+
+void ga_alloc_get_stats(ga_alloc_stats *stats)
+{
+    memset(stats, 0, sizeof(ga_alloc_stats));
+    for (alloc_shard *shard = atomic_load_explicit(&gShards, memory_order_acquire); shard; shard = shard->next) {
+        stats->bytes_current   += atomic_load_explicit(&shard->bytes_cur, memory_order_relaxed);
+        stats->bytes_total     += atomic_load_explicit(&shard->bytes_tot, memory_order_relaxed);
+        stats->regions_current += atomic_load_explicit(&shard->regions_cur, memory_order_relaxed);
+        stats->regions_total   += atomic_load_explicit(&shard->regions_tot, memory_order_relaxed);
+        stats->bytes_peak      += atomic_load_explicit(&shard->bytes_peak, memory_order_relaxed);
+        stats->regions_peak    += atomic_load_explicit(&shard->regions_peak, memory_order_relaxed);
+        for (int i = 0; i < GA_ALLOC_TAG_COUNT; i++) {
+            stats->tag_bytes[i]   += atomic_load_explicit(&shard->tag_bytes[i], memory_order_relaxed);
+            stats->tag_regions[i] += atomic_load_explicit(&shard->tag_regions[i], memory_order_relaxed);
+        }
+        for (int i = 0; i < GA_ALLOC_SIZE_CLASSES; i++) {
+            stats->size_classes[i] += atomic_load_explicit(&shard->size_classes[i], memory_order_relaxed);
+        }
+    }
+    // A shard that only frees has no peak, so the sum can fall below the current value
+    if (stats->bytes_peak < stats->bytes_current) stats->bytes_peak = stats->bytes_current;
+    if (stats->regions_peak < stats->regions_current) stats->regions_peak = stats->regions_current;
+}
+
+const char* ga_alloc_tag_name(ga_alloc_tag tag)
+{
+    assert(tag < GA_ALLOC_TAG_COUNT);
+    return gTagNames[tag];
+}
+
+void ga_print_alloc_info()
+{
+    ga_alloc_stats stats;
+    ga_alloc_get_stats(&stats);
+    printf("Currently allocated:   %zu bytes, %zu regions\n", stats.bytes_current, stats.regions_current);
+    printf("Peak:                  %zu bytes, %zu regions\n", stats.bytes_peak, stats.regions_peak);
+    printf("Total allocated:       %zu bytes, %zu regions\n", stats.bytes_total, stats.regions_total);
+    for (int i = 0; i < GA_ALLOC_TAG_COUNT; i++) {
+        if (!stats.tag_regions[i]) continue;
+        printf("  %-20s %zu bytes, %zu regions\n", gTagNames[i], stats.tag_bytes[i], stats.tag_regions[i]);
+    }
+    printf("Size classes:\n");
+    for (int i = 0; i < GA_ALLOC_SIZE_CLASSES; i++) {
+        if (!stats.size_classes[i]) continue;
+        printf("  < %-10zu %zu\n", (size_t)1 << i, stats.size_classes[i]);
+    }
+}
@@ -0,0 +1,199 @@
+#include "ga/clock.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <time.h>
+#include <errno.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/thread.h"
+#include "ga/realtime.h"
+#include "ga/histogram.h"
+#include "ga/util/time.h"
+#include "config.h"
+
+typedef char cacheline_pad [CACHELINE_SIZE];
+
+struct ga_clock {
+    unsigned int        sample_rate;
+    unsigned int        frames;
+    ga_clock_callback   callback;
+    void                *data;
+    ga_thread           *thread;
+    atomic_uint         running;
+    atomic_uint         freewheel;
+    atomic_uint         reset;                  //  Set by ga_clock_reset_stats, cleared by the clock thread
+    ga_histogram *_Atomic histogram;            //  Callback durations
+    cacheline_pad       pad;
+
+    // Written by the clock thread only
+    atomic_ullong       cycles, misses, frame_count, total_ns, max_ns, max_late_ns;
+};
+
+// -----------------------------------------------------------------------------
+
+static void sleep_until(uint64_t deadline)
+{
+#if LINUX
+    struct timespec ts = { deadline / 1000000000ull, deadline % 1000000000ull };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#else
+    // No absolute sleep, recompute the remaining time after every wakeup
+    uint64_t now;
+    while ((now = ga_now_ns()) < deadline) {
+        uint64_t remaining = deadline - now;
+        struct timespec ts = { remaining / 1000000000ull, remaining % 1000000000ull };
+        nanosleep(&ts, NULL);
+    }
+#endif
+}
+
+// Duration of a number of frames, split so that it doesn't overflow after four days at 48 kHz
+static inline uint64_t frames_to_ns(uint64_t frames, unsigned int sample_rate)
+{
+    return frames / sample_rate * 1000000000ull + frames % sample_rate * 1000000000ull / sample_rate;
+}
+
+static inline void store(atomic_ullong *counter, uint64_t value)
+{
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+static inline uint64_t load(atomic_ullong *counter)
+{
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void* clock_thread(void *data)
+{
+    ga_clock *clock = data;
+
+    uint64_t frame = 0;                         //  Frames since start
+    uint64_t start = ga_now_ns();                  //  Time of frame `anchor`
+    uint64_t anchor = 0;
+    bool was_freewheeling = false;
+
+    while (atomic_load_explicit(&clock->running, memory_order_acquire)) {
+        if (atomic_load_explicit(&clock->reset, memory_order_acquire)) {
+            store(&clock->cycles, 0);
+            store(&clock->misses, 0);
+            store(&clock->frame_count, 0);
+            store(&clock->total_ns, 0);
+            store(&clock->max_ns, 0);
+            store(&clock->max_late_ns, 0);
+            atomic_store_explicit(&clock->reset, 0, memory_order_release);
+        }
+
+        bool freewheel = atomic_load_explicit(&clock->freewheel, memory_order_relaxed);
+        if (was_freewheeling && !freewheel) {
+            start = ga_now_ns();
+            anchor = frame;
+        }
+        was_freewheeling = freewheel;
+
+        uint64_t begin = ga_now_ns();
+        if (!freewheel) {
+            uint64_t deadline = start + frames_to_ns(frame - anchor, clock->sample_rate);
+            if (begin > deadline) {
+                uint64_t late = begin - deadline;
+                if (late > load(&clock->max_late_ns)) store(&clock->max_late_ns, late);
+            }
+        }
+
+        ga_realtime_enter();
+        clock->callback(clock->data, frame, clock->frames);
+        ga_realtime_exit();
+
+        uint64_t end = ga_now_ns();
+        uint64_t duration = end - begin;
+        frame += clock->frames;
+
+        store(&clock->cycles, load(&clock->cycles) + 1);
+        store(&clock->frame_count, load(&clock->frame_count) + clock->frames);
+        store(&clock->total_ns, load(&clock->total_ns) + duration);
+        if (duration > load(&clock->max_ns)) store(&clock->max_ns, duration);
+        ga_histogram *histogram = atomic_load_explicit(&clock->histogram, memory_order_acquire);
+        if (histogram) ga_histogram_record(histogram, duration);
+
+        if (freewheel) continue;
+
+        uint64_t next = start + frames_to_ns(frame - anchor, clock->sample_rate);
+        if (end > next) {
+            store(&clock->misses, load(&clock->misses) + 1);
+            start = end;
+            anchor = frame;
+        } else {
+            sleep_until(next);
+        }
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+ga_clock* ga_clock_create(unsigned int sample_rate, unsigned int frames, ga_clock_callback callback, void *data, const ga_thread_attr *attr)
+{
+    assert(sample_rate && frames && callback);
+
+    ga_clock *clock = ga_newc_aligned(ga_clock);
+    clock->sample_rate = sample_rate;
+    clock->frames = frames;
+    clock->callback = callback;
+    clock->data = data;
+    atomic_init(&clock->running, 1);
+
+    ga_thread_attr clock_attr;
+    if (attr) {
+        clock_attr = *attr;
+    } else {
+        clock_attr = GA_THREAD_ATTR_DEFAULT;
+        clock_attr.policy = GA_THREAD_POLICY_FIFO;
+        clock_attr.priority = GA_CLOCK_DEFAULT_PRIORITY;
+        clock_attr.prefault_stack = true;
+    }
+    if (!clock_attr.name) clock_attr.name = "clock";
+
+    clock->thread = ga_thread_create_with_attr(clock_thread, clock, &clock_attr);
+    return clock;
+}
+
+void ga_clock_destroy(ga_clock *clock)
+{
+    atomic_store_explicit(&clock->running, 0, memory_order_release);
+    ga_thread_join(clock->thread);
+    ga_free(clock);
+}
+
+void ga_clock_set_freewheel(ga_clock *clock, bool freewheel)
+{
+    atomic_store_explicit(&clock->freewheel, freewheel, memory_order_relaxed);
+}
+
+bool ga_clock_is_freewheeling(ga_clock *clock)
+{
+    return atomic_load_explicit(&clock->freewheel, memory_order_relaxed) ? true : false;
+}
+
+void ga_clock_get_stats(ga_clock *clock, ga_clock_stats *stats)
+{
+    stats->cycles = load(&clock->cycles);
+    stats->misses = load(&clock->misses);
+    stats->frames = load(&clock->frame_count);
+    stats->period_ns = (uint64_t)clock->frames * 1000000000ull / clock->sample_rate;
+    stats->total_ns = load(&clock->total_ns);
+    stats->max_ns = load(&clock->max_ns);
+    stats->max_late_ns = load(&clock->max_late_ns);
+}
+
+void ga_clock_set_histogram(ga_clock *clock, ga_histogram *histogram)
+{
+    atomic_store_explicit(&clock->histogram, histogram, memory_order_release);
+}
+
+void ga_clock_reset_stats(ga_clock *clock)
+{
+    // Applied by the clock thread before its next cycle
+    atomic_store_explicit(&clock->reset, 1, memory_order_release);
+}
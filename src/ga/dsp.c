@@ -0,0 +1,102 @@
+#include "ga/dsp.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+
+#define PI 3.14159265358979323846
+
+ga_dsp_kernels ga_dsp_current;
+static ga_dsp_isa gIsa;
+
+static const char *gIsaNames[GA_DSP_ISA_COUNT] = {
+    "scalar",
+    "sse2",
+    "avx2",
+    "avx512"
+};
+
+// -----------------------------------------------------------------------------
+
+static const ga_dsp_kernels* kernels_for(ga_dsp_isa isa)
+{
+    switch (isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    case GA_DSP_SSE2:   return &ga_dsp_sse2;
+    case GA_DSP_AVX2:   return &ga_dsp_avx2;
+    case GA_DSP_AVX512: return &ga_dsp_avx512;
+#endif
+    default:            return &ga_dsp_scalar;
+    }
+}
+
+static bool is_supported(ga_dsp_isa isa)
+{
+    switch (isa) {
+    case GA_DSP_SCALAR:
+        return true;
+#if defined(__x86_64__) || defined(__i386__)
+    case GA_DSP_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case GA_DSP_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case GA_DSP_AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+// Runs before main, so the kernels are never called unselected
+__attribute__((constructor))
+static void select_kernels()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+#endif
+    ga_dsp_set_isa(ga_dsp_best_isa());
+}
+
+// -----------------------------------------------------------------------------
+
+float* ga_dsp_alloc(size_t n)
+{
+    return ga_calloc_aligned(GA_DSP_ALIGNMENT, n ? n : 1, sizeof(float));
+}
+
+ga_dsp_isa ga_dsp_get_isa()
+{
+    return gIsa;
+}
+
+ga_dsp_isa ga_dsp_best_isa()
+{
+    ga_dsp_isa isa = GA_DSP_ISA_COUNT - 1;
+    while (!is_supported(isa)) isa--;
+    return isa;
+}
+
+bool ga_dsp_set_isa(ga_dsp_isa isa)
+{
+    if (isa >= GA_DSP_ISA_COUNT || !is_supported(isa)) return false;
+    ga_dsp_current = *kernels_for(isa);
+    gIsa = isa;
+    return true;
+}
+
+const char* ga_dsp_isa_name(ga_dsp_isa isa)
+{
+    return isa < GA_DSP_ISA_COUNT ? gIsaNames[isa] : "unknown";
+}
+
+void ga_dsp_pan_gains(float pan, float *left_gain, float *right_gain)
+{
+    if (pan < -1.0f) pan = -1.0f;
+    if (pan > 1.0f) pan = 1.0f;
+    double angle = (pan + 1.0) * PI / 4.0;
+    *left_gain = cos(angle);
+    *right_gain = sin(angle);
+}
@@ -0,0 +1,151 @@
+#include "ga/dsp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <stdlib.h>
+#include <immintrin.h>
+
+#define TARGET __attribute__((target("avx512f")))
+#define WIDTH 16
+
+// The remainders are handled with masked loads and stores, instead of a scalar loop
+
+TARGET static inline __mmask16 tail_mask(size_t remaining)
+{
+    return (__mmask16)((1u << remaining) - 1);
+}
+
+TARGET static void clear(float *dst, size_t n)
+{
+    size_t i = 0;
+    __m512 zero = _mm512_setzero_ps();
+    for (; i + WIDTH <= n; i += WIDTH) {
+        _mm512_storeu_ps(dst + i, zero);
+    }
+    if (i < n) _mm512_mask_storeu_ps(dst + i, tail_mask(n - i), zero);
+}
+
+TARGET static void copy(float *dst, const float *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + WIDTH <= n; i += WIDTH) {
+        _mm512_storeu_ps(dst + i, _mm512_loadu_ps(src + i));
+    }
+    if (i < n) {
+        __mmask16 mask = tail_mask(n - i);
+        _mm512_mask_storeu_ps(dst + i, mask, _mm512_maskz_loadu_ps(mask, src + i));
+    }
+}
+
+TARGET static void add(float *dst, const float *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + WIDTH <= n; i += WIDTH) {
+        _mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(dst + i), _mm512_loadu_ps(src + i)));
+    }
+    if (i < n) {
+        __mmask16 mask = tail_mask(n - i);
+        __m512 sum = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, dst + i), _mm512_maskz_loadu_ps(mask, src + i));
+        _mm512_mask_storeu_ps(dst + i, mask, sum);
+    }
+}
+
+TARGET static void mix_ramp(float *dst, const float *src, size_t n, float start, float step)
+{
+    size_t i = 0;
+    __m512 index = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512 vstart = _mm512_set1_ps(start), vstep = _mm512_set1_ps(step), vwidth = _mm512_set1_ps(WIDTH);
+    for (; i < n; i += WIDTH) {
+        __mmask16 mask = n - i >= WIDTH ? 0xffff : tail_mask(n - i);
+        __m512 gain = _mm512_add_ps(vstart, _mm512_mul_ps(vstep, index));
+        __m512 value = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, src + i), gain);
+        _mm512_mask_storeu_ps(dst + i, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, dst + i), value));
+        index = _mm512_add_ps(index, vwidth);
+    }
+}
+
+TARGET static void gain_ramp(float *dst, size_t n, float start, float step)
+{
+    size_t i = 0;
+    __m512 index = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512 vstart = _mm512_set1_ps(start), vstep = _mm512_set1_ps(step), vwidth = _mm512_set1_ps(WIDTH);
+    for (; i < n; i += WIDTH) {
+        __mmask16 mask = n - i >= WIDTH ? 0xffff : tail_mask(n - i);
+        __m512 gain = _mm512_add_ps(vstart, _mm512_mul_ps(vstep, index));
+        _mm512_mask_storeu_ps(dst + i, mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, dst + i), gain));
+        index = _mm512_add_ps(index, vwidth);
+    }
+}
+
+TARGET static void pan(float *left, float *right, const float *src, size_t n, float left_gain, float right_gain)
+{
+    size_t i = 0;
+    __m512 vleft = _mm512_set1_ps(left_gain), vright = _mm512_set1_ps(right_gain);
+    for (; i < n; i += WIDTH) {
+        __mmask16 mask = n - i >= WIDTH ? 0xffff : tail_mask(n - i);
+        __m512 value = _mm512_maskz_loadu_ps(mask, src + i);
+        _mm512_mask_storeu_ps(left + i, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, left + i), _mm512_mul_ps(value, vleft)));
+        _mm512_mask_storeu_ps(right + i, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, right + i), _mm512_mul_ps(value, vright)));
+    }
+}
+
+TARGET static float peak(const float *src, size_t n)
+{
+    size_t i = 0;
+    __m512 vpeak = _mm512_setzero_ps();
+    for (; i < n; i += WIDTH) {
+        __mmask16 mask = n - i >= WIDTH ? 0xffff : tail_mask(n - i);
+        vpeak = _mm512_max_ps(_mm512_abs_ps(_mm512_maskz_loadu_ps(mask, src + i)), vpeak);
+    }
+    return _mm512_reduce_max_ps(vpeak);
+}
+
+TARGET static float sum_squares(const float *src, size_t n)
+{
+    size_t i = 0;
+    __m512 vsum = _mm512_setzero_ps();
+    for (; i < n; i += WIDTH) {
+        __mmask16 mask = n - i >= WIDTH ? 0xffff : tail_mask(n - i);
+        __m512 value = _mm512_maskz_loadu_ps(mask, src + i);
+        vsum = _mm512_add_ps(vsum, _mm512_mul_ps(value, value));
+    }
+    return _mm512_reduce_add_ps(vsum);
+}
+
+TARGET static void clip(float *dst, size_t n, float limit)
+{
+    size_t i = 0;
+    __m512 high = _mm512_set1_ps(limit), low = _mm512_set1_ps(-limit);
+    for (; i < n; i += WIDTH) {
+        __mmask16 mask = n - i >= WIDTH ? 0xffff : tail_mask(n - i);
+        __m512 value = _mm512_maskz_loadu_ps(mask, dst + i);
+        // min and max return their second operand if either is NaN, which keeps NaN like the scalar version
+        _mm512_mask_storeu_ps(dst + i, mask, _mm512_max_ps(low, _mm512_min_ps(high, value)));
+    }
+}
+
+TARGET static float dot(const float *a, const float *b, size_t n)
+{
+    size_t i = 0;
+    __m512 vsum = _mm512_setzero_ps();
+    for (; i < n; i += WIDTH) {
+        __mmask16 mask = n - i >= WIDTH ? 0xffff : tail_mask(n - i);
+        vsum = _mm512_add_ps(vsum, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i)));
+    }
+    return _mm512_reduce_add_ps(vsum);
+}
+
+const ga_dsp_kernels ga_dsp_avx512 = {
+    clear,
+    copy,
+    add,
+    mix_ramp,
+    gain_ramp,
+    pan,
+    peak,
+    sum_squares,
+    clip,
+    dot
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "ga/dsp.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// The reference versions, which the vector versions must match (see ga/dsp.h)
+
+static void clear(float *dst, size_t n)
+{
+    memset(dst, 0, n * sizeof(float));
+}
+
+static void copy(float *dst, const float *src, size_t n)
+{
+    memmove(dst, src, n * sizeof(float));
+}
+
+static void add(float *dst, const float *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        dst[i] += src[i];
+    }
+}
+
+static void mix_ramp(float *dst, const float *src, size_t n, float start, float step)
+{
+    for (size_t i = 0; i < n; i++) {
+        float gain = start + step * (float)i;
+        dst[i] += src[i] * gain;
+    }
+}
+
+static void gain_ramp(float *dst, size_t n, float start, float step)
+{
+    for (size_t i = 0; i < n; i++) {
+        float gain = start + step * (float)i;
+        dst[i] *= gain;
+    }
+}
+
+static void pan(float *left, float *right, const float *src, size_t n, float left_gain, float right_gain)
+{
+    for (size_t i = 0; i < n; i++) {
+        left[i] += src[i] * left_gain;
+        right[i] += src[i] * right_gain;
+    }
+}
+
+static float peak(const float *src, size_t n)
+{
+    float peak = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        float value = fabsf(src[i]);
+        if (value > peak) peak = value;
+    }
+    return peak;
+}
+
+static float sum_squares(const float *src, size_t n)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sum += (double)src[i] * src[i];
+    }
+    return sum;
+}
+
+static void clip(float *dst, size_t n, float limit)
+{
+    for (size_t i = 0; i < n; i++) {
+        float value = dst[i];
+        if (value > limit) value = limit;
+        if (value < -limit) value = -limit;
+        dst[i] = value;
+    }
+}
+
+static float dot(const float *a, const float *b, size_t n)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sum += (double)a[i] * b[i];
+    }
+    return sum;
+}
+
+const ga_dsp_kernels ga_dsp_scalar = {
+    clear,
+    copy,
+    add,
+    mix_ramp,
+    gain_ramp,
+    pan,
+    peak,
+    sum_squares,
+    clip,
+    dot
+};
@@ -0,0 +1,160 @@
+#include "ga/dsp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <stdlib.h>
+#include <math.h>
+#include <immintrin.h>
+
+#define TARGET __attribute__((target("sse2")))
+#define WIDTH 4
+
+TARGET static void clear(float *dst, size_t n)
+{
+    size_t i = 0;
+    __m128 zero = _mm_setzero_ps();
+    for (; i + WIDTH <= n; i += WIDTH) {
+        _mm_storeu_ps(dst + i, zero);
+    }
+    for (; i < n; i++) dst[i] = 0.0f;
+}
+
+TARGET static void copy(float *dst, const float *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + WIDTH <= n; i += WIDTH) {
+        _mm_storeu_ps(dst + i, _mm_loadu_ps(src + i));
+    }
+    for (; i < n; i++) dst[i] = src[i];
+}
+
+TARGET static void add(float *dst, const float *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + WIDTH <= n; i += WIDTH) {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+    }
+    for (; i < n; i++) dst[i] += src[i];
+}
+
+TARGET static void mix_ramp(float *dst, const float *src, size_t n, float start, float step)
+{
+    size_t i = 0;
+    __m128 index = _mm_setr_ps(0, 1, 2, 3);
+    __m128 vstart = _mm_set1_ps(start), vstep = _mm_set1_ps(step), vwidth = _mm_set1_ps(WIDTH);
+    for (; i + WIDTH <= n; i += WIDTH) {
+        __m128 gain = _mm_add_ps(vstart, _mm_mul_ps(vstep, index));
+        __m128 value = _mm_mul_ps(_mm_loadu_ps(src + i), gain);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), value));
+        index = _mm_add_ps(index, vwidth);
+    }
+    for (; i < n; i++) dst[i] += src[i] * (start + step * (float)i);
+}
+
+TARGET static void gain_ramp(float *dst, size_t n, float start, float step)
+{
+    size_t i = 0;
+    __m128 index = _mm_setr_ps(0, 1, 2, 3);
+    __m128 vstart = _mm_set1_ps(start), vstep = _mm_set1_ps(step), vwidth = _mm_set1_ps(WIDTH);
+    for (; i + WIDTH <= n; i += WIDTH) {
+        __m128 gain = _mm_add_ps(vstart, _mm_mul_ps(vstep, index));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), gain));
+        index = _mm_add_ps(index, vwidth);
+    }
+    for (; i < n; i++) dst[i] *= start + step * (float)i;
+}
+
+TARGET static void pan(float *left, float *right, const float *src, size_t n, float left_gain, float right_gain)
+{
+    size_t i = 0;
+    __m128 vleft = _mm_set1_ps(left_gain), vright = _mm_set1_ps(right_gain);
+    for (; i + WIDTH <= n; i += WIDTH) {
+        __m128 value = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(value, vleft)));
+        _mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(value, vright)));
+    }
+    for (; i < n; i++) {
+        left[i] += src[i] * left_gain;
+        right[i] += src[i] * right_gain;
+    }
+}
+
+TARGET static float peak(const float *src, size_t n)
+{
+    size_t i = 0;
+    __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 vpeak = _mm_setzero_ps();
+    for (; i + WIDTH <= n; i += WIDTH) {
+        vpeak = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(src + i), mask), vpeak);
+    }
+    float lanes[WIDTH], peak = 0.0f;
+    _mm_storeu_ps(lanes, vpeak);
+    for (int j = 0; j < WIDTH; j++) {
+        if (lanes[j] > peak) peak = lanes[j];
+    }
+    for (; i < n; i++) {
+        float value = fabsf(src[i]);
+        if (value > peak) peak = value;
+    }
+    return peak;
+}
+
+TARGET static float sum_squares(const float *src, size_t n)
+{
+    size_t i = 0;
+    __m128 vsum = _mm_setzero_ps();
+    for (; i + WIDTH <= n; i += WIDTH) {
+        __m128 value = _mm_loadu_ps(src + i);
+        vsum = _mm_add_ps(vsum, _mm_mul_ps(value, value));
+    }
+    float lanes[WIDTH], sum = 0.0f;
+    _mm_storeu_ps(lanes, vsum);
+    for (int j = 0; j < WIDTH; j++) sum += lanes[j];
+    for (; i < n; i++) sum += src[i] * src[i];
+    return sum;
+}
+
+TARGET static void clip(float *dst, size_t n, float limit)
+{
+    size_t i = 0;
+    __m128 high = _mm_set1_ps(limit), low = _mm_set1_ps(-limit);
+    for (; i + WIDTH <= n; i += WIDTH) {
+        // min and max return their second operand if either is NaN, which keeps NaN like the scalar version
+        _mm_storeu_ps(dst + i, _mm_max_ps(low, _mm_min_ps(high, _mm_loadu_ps(dst + i))));
+    }
+    for (; i < n; i++) {
+        float value = dst[i];
+        if (value > limit) value = limit;
+        if (value < -limit) value = -limit;
+        dst[i] = value;
+    }
+}
+
+TARGET static float dot(const float *a, const float *b, size_t n)
+{
+    size_t i = 0;
+    __m128 vsum = _mm_setzero_ps();
+    for (; i + WIDTH <= n; i += WIDTH) {
+        vsum = _mm_add_ps(vsum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    float lanes[WIDTH], sum = 0.0f;
+    _mm_storeu_ps(lanes, vsum);
+    for (int j = 0; j < WIDTH; j++) sum += lanes[j];
+    for (; i < n; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+const ga_dsp_kernels ga_dsp_sse2 = {
+    clear,
+    copy,
+    add,
+    mix_ramp,
+    gain_ramp,
+    pan,
+    peak,
+    sum_squares,
+    clip,
+    dot
+};
+
+#endif
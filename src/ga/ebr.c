@@ -0,0 +1,182 @@
+#include "ga/ebr.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/thread.h"
+
+typedef struct retired retired;
+
+struct retired {
+    void               *ptr;
+    ga_ebr_destructor  destructor;
+    size_t             epoch;                   //  Global epoch when retired
+    retired            *next;
+};
+
+struct ga_ebr {
+    atomic_size_t           epoch;              //  Global epoch
+    char                    pad[CACHELINE_SIZE - sizeof(atomic_size_t)];
+    _Atomic(ga_ebr_reader*) readers;            //  All readers, never unlinked (reused after unregister)
+    _Atomic(retired*)       incoming;           //  Retired by ga_ebr_retire, not yet seen by the collector
+    retired                 *pending;           //  Waiting for the epoch to advance (collector only)
+    atomic_size_t           pending_count;
+    atomic_uint             collecting;         //  Only one thread collects at a time
+    atomic_uint             running;
+    unsigned int            interval;           //  Milliseconds between collections
+    ga_thread               *thread;
+};
+
+// -----------------------------------------------------------------------------
+
+// Advance the global epoch, if all active readers have seen it
+static bool try_advance(ga_ebr *ebr)
+{
+    size_t epoch = atomic_load_explicit(&ebr->epoch, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    for (ga_ebr_reader *reader = atomic_load_explicit(&ebr->readers, memory_order_acquire); reader; reader = reader->next) {
+        size_t state = atomic_load_explicit(&reader->state, memory_order_relaxed);
+        if ((state & 1) && (state >> 1) != epoch) return false;
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    atomic_store_explicit(&ebr->epoch, epoch + 1, memory_order_relaxed);
+    return true;
+}
+
+static void free_retired(retired *r)
+{
+    if (r->destructor) {
+        r->destructor(r->ptr);
+    } else {
+        ga_free(r->ptr);
+    }
+    ga_free(r);
+}
+
+void ga_ebr_collect(ga_ebr *ebr)
+{
+    unsigned int expected = 0;
+    if (!atomic_compare_exchange_strong(&ebr->collecting, &expected, 1)) return;
+
+    // Move newly retired objects to the pending list
+    retired *r = atomic_exchange_explicit(&ebr->incoming, NULL, memory_order_acquire);
+    while (r) {
+        retired *next = r->next;
+        r->next = ebr->pending;
+        ebr->pending = r;
+        r = next;
+    }
+
+    try_advance(ebr);
+    size_t epoch = atomic_load_explicit(&ebr->epoch, memory_order_relaxed);
+
+    // Free everything retired at least two epochs ago
+    size_t freed = 0;
+    retired **link = &ebr->pending;
+    while ((r = *link)) {
+        if (epoch - r->epoch >= 2) {
+            *link = r->next;
+            free_retired(r);
+            freed++;
+        } else {
+            link = &r->next;
+        }
+    }
+    atomic_fetch_sub_explicit(&ebr->pending_count, freed, memory_order_relaxed);
+
+    atomic_store_explicit(&ebr->collecting, 0, memory_order_release);
+}
+
+static void* ebr_thread(void *data)
+{
+    ga_ebr *ebr = data;
+    while (atomic_load_explicit(&ebr->running, memory_order_acquire)) {
+        ga_thread_sleep(ebr->interval);
+        ga_ebr_collect(ebr);
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+ga_ebr* ga_ebr_create(unsigned int interval_ms)
+{
+    ga_ebr *ebr = ga_newc_aligned(ga_ebr);
+    ebr->interval = interval_ms;
+    atomic_store(&ebr->running, 1);
+    ebr->thread = ga_thread_create_named(ebr_thread, ebr, "ebr");
+    return ebr;
+}
+
+void ga_ebr_destroy(ga_ebr *ebr)
+{
+    atomic_store(&ebr->running, 0);
+    ga_thread_join(ebr->thread);
+
+    ga_ebr_reader *reader = atomic_load(&ebr->readers);
+    while (reader) {
+        assert(!atomic_load(&reader->state) && "Reader still in a critical section");
+        ga_ebr_reader *next = reader->next;
+        ga_free(reader);
+        reader = next;
+    }
+    atomic_store(&ebr->readers, NULL);
+
+    // No readers left, so everything can go
+    ga_ebr_collect(ebr);
+    while (ebr->pending) {
+        retired *r = ebr->pending;
+        ebr->pending = r->next;
+        free_retired(r);
+    }
+    ga_free(ebr);
+}
+
+ga_ebr_reader* ga_ebr_register(ga_ebr *ebr)
+{
+    // Reuse an unregistered reader, if there is one
+    for (ga_ebr_reader *reader = atomic_load_explicit(&ebr->readers, memory_order_acquire); reader; reader = reader->next) {
+        unsigned int expected = 0;
+        if (atomic_load_explicit(&reader->used, memory_order_relaxed)) continue;
+        if (atomic_compare_exchange_strong(&reader->used, &expected, 1)) return reader;
+    }
+
+    ga_ebr_reader *reader = ga_newc_aligned(ga_ebr_reader);
+    reader->global_epoch = &ebr->epoch;
+    atomic_store_explicit(&reader->used, 1, memory_order_relaxed);
+    ga_ebr_reader *head = atomic_load_explicit(&ebr->readers, memory_order_relaxed);
+    do {
+        reader->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&ebr->readers, &head, reader, memory_order_release, memory_order_relaxed));
+    return reader;
+}
+
+void ga_ebr_unregister(ga_ebr_reader *reader)
+{
+    assert(!atomic_load(&reader->state) && "Unregistering reader inside a critical section");
+    atomic_store(&reader->used, 0);
+}
+
+void ga_ebr_retire(ga_ebr *ebr, void *ptr, ga_ebr_destructor destructor)
+{
+    retired *r = ga_new(retired);
+    r->ptr = ptr;
+    r->destructor = destructor;
+    // The object must be unlinked before the epoch is read
+    atomic_thread_fence(memory_order_seq_cst);
+    r->epoch = atomic_load_explicit(&ebr->epoch, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ebr->pending_count, 1, memory_order_relaxed);
+    retired *head = atomic_load_explicit(&ebr->incoming, memory_order_relaxed);
+    do {
+        r->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&ebr->incoming, &head, r, memory_order_release, memory_order_relaxed));
+}
+
+size_t ga_ebr_pending(ga_ebr *ebr)
+{
+    return atomic_load_explicit(&ebr->pending_count, memory_order_relaxed);
+}
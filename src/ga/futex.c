@@ -0,0 +1,40 @@
+#include "ga/futex.h"
+
+#include "config.h"
+#include <limits.h>
+#include <unistd.h>
+#if LINUX
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// Longest sleep when polling
+#define POLL_INTERVAL_US 100
+
+void ga_futex_wait(atomic_uint *address, unsigned int expected, unsigned long long timeout_ns)
+{
+#if LINUX
+    if (timeout_ns == GA_FUTEX_FOREVER) {
+        syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+    } else {
+        struct timespec ts = { timeout_ns / 1000000000ull, timeout_ns % 1000000000ull };
+        syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, &ts, NULL, 0);
+    }
+#else
+    if (atomic_load_explicit(address, memory_order_relaxed) != expected) return;
+    usleep(timeout_ns < POLL_INTERVAL_US * 1000ull ? timeout_ns / 1000 : POLL_INTERVAL_US);
+#endif
+}
+
+void ga_futex_wake(atomic_uint *address, int count)
+{
+#if LINUX
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#endif
+}
+
+void ga_futex_wake_all(atomic_uint *address)
+{
+    ga_futex_wake(address, INT_MAX);
+}
@@ -0,0 +1,109 @@
+#include "ga/garbage.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/thread.h"
+#include "ga/ring_buffer.h"
+
+#define BATCH_SIZE 64
+
+typedef struct item {
+    void                    *ptr;
+    ga_garbage_destructor   destructor;
+} item;
+
+struct ga_garbage {
+    ga_ring_buffer      *channel;               //  Holds items, written by the realtime thread
+    atomic_size_t       max_backlog;            //  Written by the pushing thread only
+    atomic_size_t       overflows;              //  Written by the pushing thread only
+    atomic_size_t       freed;                  //  Written by the background thread only
+    atomic_uint         running;
+    unsigned int        interval;               //  Milliseconds between collections
+    ga_thread           *thread;
+};
+
+// -----------------------------------------------------------------------------
+
+static void drain(ga_garbage *garbage)
+{
+    item batch[BATCH_SIZE];
+    for (;;) {
+        // Only ask for what is there, in whole items, so that a short read isn't counted as an underflow
+        size_t count = ga_ring_buffer_can_read(garbage->channel) / sizeof(item);
+        if (count > BATCH_SIZE) count = BATCH_SIZE;
+        if (!count) break;
+        ga_ring_buffer_read(garbage->channel, count * sizeof(item), batch);
+        for (size_t i = 0; i < count; i++) {
+            if (batch[i].destructor) {
+                batch[i].destructor(batch[i].ptr);
+            } else {
+                ga_free(batch[i].ptr);
+            }
+        }
+        size_t freed = atomic_load_explicit(&garbage->freed, memory_order_relaxed);
+        atomic_store_explicit(&garbage->freed, freed + count, memory_order_relaxed);
+    }
+}
+
+static void* garbage_thread(void *data)
+{
+    ga_garbage *garbage = data;
+    while (atomic_load_explicit(&garbage->running, memory_order_acquire)) {
+        ga_thread_sleep(garbage->interval);
+        drain(garbage);
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+ga_garbage* ga_garbage_create(size_t capacity, unsigned int interval_ms)
+{
+    assert(capacity >= BATCH_SIZE);
+    ga_garbage *garbage = ga_newc_aligned(ga_garbage);
+    garbage->channel = ga_ring_buffer_create_with_flags(capacity * sizeof(item), GA_MEM_REALTIME);
+    garbage->interval = interval_ms;
+    atomic_store(&garbage->running, 1);
+    ga_thread_attr attr = GA_THREAD_ATTR_DEFAULT;
+    attr.name = "garbage";
+    attr.policy = GA_THREAD_POLICY_IDLE;
+    garbage->thread = ga_thread_create_with_attr(garbage_thread, garbage, &attr);
+    return garbage;
+}
+
+void ga_garbage_destroy(ga_garbage *garbage)
+{
+    atomic_store(&garbage->running, 0);
+    ga_thread_join(garbage->thread);
+    drain(garbage);
+    ga_ring_buffer_destroy(garbage->channel);
+    ga_free(garbage);
+}
+
+bool ga_garbage_push(ga_garbage *garbage, void *ptr, ga_garbage_destructor destructor)
+{
+    item i = { ptr, destructor };
+    if (!ga_ring_buffer_write_atomic(garbage->channel, sizeof(item), &i)) {
+        size_t overflows = atomic_load_explicit(&garbage->overflows, memory_order_relaxed);
+        atomic_store_explicit(&garbage->overflows, overflows + 1, memory_order_relaxed);
+        return false;
+    }
+    size_t backlog = ga_ring_buffer_can_read(garbage->channel) / sizeof(item);
+    if (backlog > atomic_load_explicit(&garbage->max_backlog, memory_order_relaxed)) {
+        atomic_store_explicit(&garbage->max_backlog, backlog, memory_order_relaxed);
+    }
+    return true;
+}
+
+void ga_garbage_get_stats(ga_garbage *garbage, ga_garbage_stats *stats)
+{
+    stats->backlog     = ga_ring_buffer_can_read(garbage->channel) / sizeof(item);
+    stats->max_backlog = atomic_load_explicit(&garbage->max_backlog, memory_order_relaxed);
+    stats->overflows   = atomic_load_explicit(&garbage->overflows, memory_order_relaxed);
+    stats->freed       = atomic_load_explicit(&garbage->freed, memory_order_relaxed);
+}
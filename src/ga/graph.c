@@ -0,0 +1,333 @@
+#include "ga/graph.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/thread.h"
+#include "ga/eventcount.h"
+#include "ga/seqlock.h"
+#include "ga/queue/mpmcq.h"
+#include "ga/util/time.h"
+#include "config.h"
+
+typedef struct node {
+    atomic_int              pending;            //  Inputs not yet finished in this block
+    int                     input_count;
+    ga_graph_process_func   func;
+    void                    *data;
+    struct node             **outputs;          //  Nodes reading from this one
+    int                     output_count;
+} __attribute__((aligned(CACHELINE_SIZE))) node;
+
+struct ga_graph {
+    node                *nodes;
+    unsigned int        count, max;
+    int                 *edges;                 //  (from, to) pairs, until compiled
+    unsigned int        edge_count, edge_max;
+    node                **sources;              //  Nodes without inputs
+    unsigned int        source_count;
+    node                **output_storage;
+    ga_mpmcq            *ready;                 //  Nodes ready to run
+    bool                compiled;
+};
+
+typedef char cacheline_pad [CACHELINE_SIZE];
+
+// What a block runs, published through a seqlock so that workers never see a mix of two blocks
+typedef struct block {
+    ga_graph            *graph;
+    unsigned int        frames;
+    unsigned int        generation;
+} block;
+
+// The generation of a block in the upper half of its remaining counter
+#define REMAINING(generation, count)    (((uint64_t)(generation) << 32) | (count))
+
+typedef struct worker {
+    ga_graph_scheduler  *scheduler;
+    unsigned int        index;
+    ga_thread           *thread;
+    atomic_ullong       busy_ns;                //  Written by the owning thread only
+    cacheline_pad       pad;
+} worker;
+
+struct ga_graph_scheduler {
+    atomic_uint         generation;             //  Incremented for every block, after publishing it
+    atomic_uint         active;                 //  Workers currently looking at a block
+    ga_seqlock          lock;
+    block               current;                //  Written through lock
+    cacheline_pad       pad0;
+    atomic_ullong       remaining;              //  Generation and nodes left in the current block, see REMAINING
+    cacheline_pad       pad1;
+    ga_eventcount       wake;
+    atomic_uint         running;
+    bool                measure;
+    unsigned int        count;                  //  Workers, plus the calling thread
+    worker              *workers;
+    uint64_t            blocks, total_ns, max_ns;
+};
+
+// -----------------------------------------------------------------------------
+
+ga_graph* ga_graph_create(unsigned int max_nodes)
+{
+    ga_graph *graph = ga_newc(ga_graph);
+    graph->max = max_nodes;
+    graph->nodes = ga_calloc_aligned(CACHELINE_SIZE, max_nodes, sizeof(node));
+    graph->edge_max = max_nodes * 2;
+    graph->edges = ga_malloc(graph->edge_max * 2 * sizeof(int));
+    return graph;
+}
+
+void ga_graph_destroy(ga_graph *graph)
+{
+    if (graph->compiled) {
+        ga_free(graph->output_storage);
+        ga_free(graph->sources);
+        ga_mpmcq_destroy(graph->ready);
+    } else {
+        ga_free(graph->edges);
+    }
+    ga_free(graph->nodes);
+    ga_free(graph);
+}
+
+int ga_graph_add_node(ga_graph *graph, ga_graph_process_func func, void *data)
+{
+    assert(!graph->compiled && "Graph already compiled");
+    if (graph->count >= graph->max) fatal_error("Too many nodes in graph (max %u)", graph->max);
+    node *n = &graph->nodes[graph->count];
+    n->func = func;
+    n->data = data;
+    return graph->count++;
+}
+
+void ga_graph_connect(ga_graph *graph, int from, int to)
+{
+    assert(!graph->compiled && "Graph already compiled");
+    assert(from >= 0 && from < graph->count && to >= 0 && to < graph->count && from != to);
+    if (graph->edge_count == graph->edge_max) {
+        graph->edge_max *= 2;
+        graph->edges = ga_realloc(graph->edges, graph->edge_max * 2 * sizeof(int));
+    }
+    graph->edges[graph->edge_count * 2] = from;
+    graph->edges[graph->edge_count * 2 + 1] = to;
+    graph->edge_count++;
+}
+
+void ga_graph_compile(ga_graph *graph)
+{
+    assert(!graph->compiled && "Graph already compiled");
+    assert(graph->count && "Empty graph");
+
+    for (unsigned int i = 0; i < graph->edge_count; i++) {
+        graph->nodes[graph->edges[i * 2]].output_count++;
+        graph->nodes[graph->edges[i * 2 + 1]].input_count++;
+    }
+    graph->output_storage = ga_malloc((graph->edge_count ? graph->edge_count : 1) * sizeof(node*));
+    node **next = graph->output_storage;
+    for (unsigned int i = 0; i < graph->count; i++) {
+        graph->nodes[i].outputs = next;
+        next += graph->nodes[i].output_count;
+        graph->nodes[i].output_count = 0;
+    }
+    for (unsigned int i = 0; i < graph->edge_count; i++) {
+        node *from = &graph->nodes[graph->edges[i * 2]];
+        from->outputs[from->output_count++] = &graph->nodes[graph->edges[i * 2 + 1]];
+    }
+    ga_free(graph->edges);
+    graph->edges = NULL;
+
+    graph->sources = ga_malloc(graph->count * sizeof(node*));
+    for (unsigned int i = 0; i < graph->count; i++) {
+        node *n = &graph->nodes[i];
+        atomic_store_explicit(&n->pending, n->input_count, memory_order_relaxed);
+        if (!n->input_count) graph->sources[graph->source_count++] = n;
+    }
+
+    // Check that the graph is acyclic (Kahn's algorithm)
+    int *pending = ga_malloc(graph->count * sizeof(int));
+    node **stack = ga_malloc(graph->count * sizeof(node*));
+    unsigned int top = 0, visited = 0;
+    for (unsigned int i = 0; i < graph->count; i++) pending[i] = graph->nodes[i].input_count;
+    for (unsigned int i = 0; i < graph->source_count; i++) stack[top++] = graph->sources[i];
+    while (top) {
+        node *n = stack[--top];
+        visited++;
+        for (int i = 0; i < n->output_count; i++) {
+            if (--pending[n->outputs[i] - graph->nodes] == 0) stack[top++] = n->outputs[i];
+        }
+    }
+    ga_free(pending);
+    ga_free(stack);
+    if (visited != graph->count) fatal_error("Graph has a cycle");
+
+    size_t capacity = 2;
+    while (capacity < graph->count) capacity *= 2;
+    graph->ready = ga_mpmcq_create_with_flags(capacity, GA_MEM_REALTIME);
+    graph->compiled = true;
+}
+
+// -----------------------------------------------------------------------------
+
+static inline void execute(ga_graph_scheduler *scheduler, worker *w, ga_graph *graph, node *n, unsigned int frames)
+{
+    uint64_t start = scheduler->measure ? ga_now_ns() : 0;
+    n->func(n->data, frames);
+    // All inputs are done, so nobody else touches the counter until the next block
+    atomic_store_explicit(&n->pending, n->input_count, memory_order_relaxed);
+    for (int i = 0; i < n->output_count; i++) {
+        node *output = n->outputs[i];
+        if (atomic_fetch_sub_explicit(&output->pending, 1, memory_order_acq_rel) == 1) {
+            ga_mpmcq_push(graph->ready, output);
+        }
+    }
+    if (scheduler->measure) {
+        uint64_t busy = atomic_load_explicit(&w->busy_ns, memory_order_relaxed);
+        atomic_store_explicit(&w->busy_ns, busy + ga_now_ns() - start, memory_order_relaxed);
+    }
+    atomic_fetch_sub_explicit(&scheduler->remaining, 1, memory_order_release);
+}
+
+// Runs nodes until the block is finished; returns at once if it already was
+static void run_block(ga_graph_scheduler *scheduler, worker *w, const block *b)
+{
+    for (;;) {
+        uint64_t remaining = atomic_load_explicit(&scheduler->remaining, memory_order_seq_cst);
+        if (remaining >> 32 != b->generation || !(uint32_t)remaining) break;
+        node *n = ga_mpmcq_pop(b->graph->ready);
+        if (n) {
+            execute(scheduler, w, b->graph, n, b->frames);
+        } else {
+            ga_cpu_relax();
+        }
+    }
+}
+
+static void* worker_thread(void *data)
+{
+    worker *w = data;
+    ga_graph_scheduler *scheduler = w->scheduler;
+    unsigned int done = 0;
+
+    while (atomic_load_explicit(&scheduler->running, memory_order_acquire)) {
+        // Spin for a while waiting for the next block, then sleep
+        uint64_t spin_until = ga_now_ns() + GA_GRAPH_SPIN_US * 1000;
+        while (atomic_load_explicit(&scheduler->generation, memory_order_acquire) == done) {
+            if (ga_now_ns() > spin_until) {
+                unsigned int key = ga_eventcount_prepare(&scheduler->wake);
+                if (atomic_load_explicit(&scheduler->generation, memory_order_acquire) != done
+                        || !atomic_load_explicit(&scheduler->running, memory_order_acquire)) {
+                    ga_eventcount_cancel(&scheduler->wake);
+                    break;
+                }
+                ga_eventcount_wait(&scheduler->wake, key);
+            } else {
+                ga_cpu_relax();
+            }
+        }
+
+        // Announce ourselves before looking at the block, see ga_graph_process
+        atomic_fetch_add_explicit(&scheduler->active, 1, memory_order_seq_cst);
+        block b;
+        ga_seqlock_read(&scheduler->lock, &b, &scheduler->current, sizeof(block), GA_SEQLOCK_RETRY_FOREVER);
+        if (b.generation != done) {
+            done = b.generation;
+            run_block(scheduler, w, &b);
+        }
+        atomic_fetch_sub_explicit(&scheduler->active, 1, memory_order_release);
+    }
+    return NULL;
+}
+
+ga_graph_scheduler* ga_graph_scheduler_create(unsigned int workers, const ga_thread_attr *attr, bool measure)
+{
+    assert(workers + 1 <= GA_GRAPH_MAX_THREADS);
+    ga_graph_scheduler *scheduler = ga_newc_aligned(ga_graph_scheduler);
+    scheduler->count = workers + 1;
+    scheduler->measure = measure;
+    scheduler->workers = ga_calloc_aligned(CACHELINE_SIZE, scheduler->count, sizeof(worker));
+    ga_seqlock_init(&scheduler->lock);
+    atomic_store(&scheduler->running, 1);
+
+    ga_thread_attr worker_attr = attr ? *attr : GA_THREAD_ATTR_DEFAULT;
+    for (unsigned int i = 0; i < scheduler->count; i++) {
+        worker *w = &scheduler->workers[i];
+        w->scheduler = scheduler;
+        w->index = i;
+        if (i == 0) continue; // The thread calling ga_graph_process
+        char name[32];
+        snprintf(name, sizeof(name), "graph worker %u", i);
+        worker_attr.name = name;
+        w->thread = ga_thread_create_with_attr(worker_thread, w, &worker_attr);
+    }
+    return scheduler;
+}
+
+void ga_graph_scheduler_destroy(ga_graph_scheduler *scheduler)
+{
+    atomic_store(&scheduler->running, 0);
+    ga_eventcount_notify(&scheduler->wake);
+    for (unsigned int i = 1; i < scheduler->count; i++) {
+        ga_thread_join(scheduler->workers[i].thread);
+    }
+    ga_free(scheduler->workers);
+    ga_free(scheduler);
+}
+
+void ga_graph_process(ga_graph_scheduler *scheduler, ga_graph *graph, unsigned int frames)
+{
+    assert(graph->compiled && "Graph not compiled");
+    uint64_t start = scheduler->measure ? ga_now_ns() : 0;
+
+    block b = { graph, frames, atomic_load_explicit(&scheduler->generation, memory_order_relaxed) + 1 };
+    ga_seqlock_write(&scheduler->lock, &scheduler->current, &b, sizeof(block));
+    atomic_store_explicit(&scheduler->remaining, REMAINING(b.generation, graph->count), memory_order_seq_cst);
+    for (unsigned int i = 0; i < graph->source_count; i++) {
+        ga_mpmcq_push(graph->ready, graph->sources[i]);
+    }
+    atomic_store_explicit(&scheduler->generation, b.generation, memory_order_release);
+    ga_eventcount_notify(&scheduler->wake);
+
+    run_block(scheduler, &scheduler->workers[0], &b);
+
+    // Wait for workers still inside the block, so that the graph can be
+    // changed or destroyed once we return. A worker arriving later reads
+    // a whole block from the seqlock and skips it without touching the
+    // graph, since its remaining count is zero or tagged with a newer
+    // generation.
+    while (atomic_load_explicit(&scheduler->active, memory_order_seq_cst)) ga_cpu_relax();
+
+    if (scheduler->measure) {
+        uint64_t elapsed = ga_now_ns() - start;
+        scheduler->blocks++;
+        scheduler->total_ns += elapsed;
+        if (elapsed > scheduler->max_ns) scheduler->max_ns = elapsed;
+    }
+}
+
+void ga_graph_get_stats(ga_graph_scheduler *scheduler, ga_graph_stats *stats)
+{
+    memset(stats, 0, sizeof(ga_graph_stats));
+    stats->blocks = scheduler->blocks;
+    stats->total_ns = scheduler->total_ns;
+    stats->max_ns = scheduler->max_ns;
+    stats->threads = scheduler->count;
+    for (unsigned int i = 0; i < scheduler->count; i++) {
+        stats->busy_ns[i] = atomic_load_explicit(&scheduler->workers[i].busy_ns, memory_order_relaxed);
+    }
+}
+
+void ga_graph_reset_stats(ga_graph_scheduler *scheduler)
+{
+    scheduler->blocks = scheduler->total_ns = scheduler->max_ns = 0;
+    for (unsigned int i = 0; i < scheduler->count; i++) {
+        atomic_store_explicit(&scheduler->workers[i].busy_ns, 0, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,259 @@
+#include "ga/histogram.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "config.h"
+
+_Thread_local unsigned int ga_histogram_thread_index = 0;
+static atomic_uint gNextThreadIndex = 1;
+
+// Merged view of all shards
+typedef struct merged {
+    uint64_t count, sum, min, max;
+    uint64_t buckets[GA_HISTOGRAM_BUCKETS];
+} merged;
+
+static const double default_percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+#define DEFAULT_PERCENTILES (sizeof(default_percentiles) / sizeof(default_percentiles[0]))
+
+// -----------------------------------------------------------------------------
+
+unsigned int ga_histogram_assign_thread_index()
+{
+    unsigned int index = atomic_fetch_add(&gNextThreadIndex, 1);
+    if (!index) index = atomic_fetch_add(&gNextThreadIndex, 1);     // Wrapped around
+    ga_histogram_thread_index = index;
+    return index;
+}
+
+static inline uint64_t bucket_low(unsigned int bucket)
+{
+    if (bucket < GA_HISTOGRAM_SUB_COUNT) return bucket;
+    unsigned int i = bucket - GA_HISTOGRAM_SUB_COUNT;
+    unsigned int shift = i / (GA_HISTOGRAM_SUB_COUNT / 2) + 1;
+    uint64_t sub = i % (GA_HISTOGRAM_SUB_COUNT / 2) + GA_HISTOGRAM_SUB_COUNT / 2;
+    return sub << shift;
+}
+
+static inline uint64_t bucket_high(unsigned int bucket)
+{
+    if (bucket < GA_HISTOGRAM_SUB_COUNT) return bucket;
+    unsigned int shift = (bucket - GA_HISTOGRAM_SUB_COUNT) / (GA_HISTOGRAM_SUB_COUNT / 2) + 1;
+    return bucket_low(bucket) + ((1ull << shift) - 1);
+}
+
+static void reset_shard(ga_histogram_shard *shard)
+{
+    atomic_store_explicit(&shard->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&shard->sum, 0, memory_order_relaxed);
+    for (unsigned int i = 0; i < GA_HISTOGRAM_BUCKETS; i++) {
+        atomic_store_explicit(&shard->buckets[i], 0, memory_order_relaxed);
+    }
+}
+
+static bool bucket_used(ga_histogram *histogram, unsigned int bucket)
+{
+    for (unsigned int s = 0; s < histogram->shard_count; s++) {
+        if (atomic_load_explicit(&histogram->shards[s].buckets[bucket], memory_order_relaxed)) return true;
+    }
+    return false;
+}
+
+static void merge(ga_histogram *histogram, merged *m)
+{
+    memset(m, 0, sizeof(merged));
+    for (unsigned int s = 0; s < histogram->shard_count; s++) {
+        ga_histogram_shard *shard = &histogram->shards[s];
+        m->count += atomic_load_explicit(&shard->count, memory_order_acquire);
+        m->sum += atomic_load_explicit(&shard->sum, memory_order_relaxed);
+        for (unsigned int i = 0; i < GA_HISTOGRAM_BUCKETS; i++) {
+            m->buckets[i] += atomic_load_explicit(&shard->buckets[i], memory_order_relaxed);
+        }
+    }
+
+    // Minimum and maximum to within their buckets, from the lowest and highest used ones
+    unsigned int low = 0, high = GA_HISTOGRAM_BUCKETS;
+    while (low < GA_HISTOGRAM_BUCKETS && !m->buckets[low]) low++;
+    while (high > 0 && !m->buckets[high - 1]) high--;
+    m->min = high ? bucket_low(low) : 0;
+    m->max = high ? bucket_high(high - 1) : 0;
+}
+
+// Values at the given percentiles, in any order. The buckets are walked
+// once for increasing percentiles, and again from the start after a lower one.
+static void merged_percentiles(merged *m, const double *percentiles, uint64_t *values, unsigned int count)
+{
+    // The buckets may have been read after count, so use their own total
+    uint64_t total = 0;
+    for (unsigned int i = 0; i < GA_HISTOGRAM_BUCKETS; i++) total += m->buckets[i];
+
+    unsigned int bucket = 0;
+    uint64_t seen = 0;
+    for (unsigned int p = 0; p < count; p++) {
+        if (!total) {
+            values[p] = 0;
+            continue;
+        }
+        double percentile = percentiles[p] < 0 ? 0 : percentiles[p] > 100 ? 100 : percentiles[p];
+        uint64_t rank = (uint64_t)(percentile / 100.0 * total + 0.5);
+        if (rank < 1) rank = 1;
+        if (rank > total) rank = total;
+        if (rank <= seen) {
+            bucket = 0;
+            seen = 0;
+        }
+        while (seen + m->buckets[bucket] < rank) {
+            seen += m->buckets[bucket++];
+        }
+        values[p] = bucket_high(bucket);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+ga_histogram* ga_histogram_create(unsigned int shards)
+{
+    if (!shards) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        shards = cpus > 0 ? cpus : 1;
+    }
+    if (shards > GA_HISTOGRAM_MAX_SHARDS) shards = GA_HISTOGRAM_MAX_SHARDS;
+
+    ga_histogram *histogram = ga_newc(ga_histogram);
+    histogram->shard_count = shards;
+    histogram->shards = ga_malloc_aligned(CACHELINE_SIZE, shards * sizeof(ga_histogram_shard));
+    ga_histogram_reset(histogram);
+    return histogram;
+}
+
+void ga_histogram_destroy(ga_histogram *histogram)
+{
+    ga_free(histogram->shards);
+    ga_free(histogram);
+}
+
+void ga_histogram_reset(ga_histogram *histogram)
+{
+    for (unsigned int s = 0; s < histogram->shard_count; s++) {
+        reset_shard(&histogram->shards[s]);
+    }
+}
+
+// Adds the counts of other into the first shard of histogram
+void ga_histogram_merge(ga_histogram *histogram, ga_histogram *other)
+{
+    merged *m = ga_malloc(sizeof(merged));
+    merge(other, m);
+
+    ga_histogram_shard *shard = &histogram->shards[0];
+    for (unsigned int i = 0; i < GA_HISTOGRAM_BUCKETS; i++) {
+        if (m->buckets[i]) atomic_fetch_add_explicit(&shard->buckets[i], m->buckets[i], memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&shard->sum, m->sum, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->count, m->count, memory_order_release);
+    ga_free(m);
+}
+
+uint64_t ga_histogram_count(ga_histogram *histogram)
+{
+    uint64_t count = 0;
+    for (unsigned int s = 0; s < histogram->shard_count; s++) {
+        count += atomic_load_explicit(&histogram->shards[s].count, memory_order_relaxed);
+    }
+    return count;
+}
+
+uint64_t ga_histogram_min(ga_histogram *histogram)
+{
+    for (unsigned int i = 0; i < GA_HISTOGRAM_BUCKETS; i++) {
+        if (bucket_used(histogram, i)) return bucket_low(i);
+    }
+    return 0;
+}
+
+uint64_t ga_histogram_max(ga_histogram *histogram)
+{
+    for (unsigned int i = GA_HISTOGRAM_BUCKETS; i > 0; i--) {
+        if (bucket_used(histogram, i - 1)) return bucket_high(i - 1);
+    }
+    return 0;
+}
+
+double ga_histogram_mean(ga_histogram *histogram)
+{
+    uint64_t count = 0, sum = 0;
+    for (unsigned int s = 0; s < histogram->shard_count; s++) {
+        count += atomic_load_explicit(&histogram->shards[s].count, memory_order_acquire);
+        sum += atomic_load_explicit(&histogram->shards[s].sum, memory_order_relaxed);
+    }
+    return count ? (double)sum / count : 0;
+}
+
+uint64_t ga_histogram_percentile(ga_histogram *histogram, double percentile)
+{
+    uint64_t value;
+    ga_histogram_percentiles(histogram, &percentile, &value, 1);
+    return value;
+}
+
+void ga_histogram_percentiles(ga_histogram *histogram, const double *percentiles, uint64_t *values, unsigned int count)
+{
+    merged *m = ga_malloc(sizeof(merged));
+    merge(histogram, m);
+    merged_percentiles(m, percentiles, values, count);
+    ga_free(m);
+}
+
+// -----------------------------------------------------------------------------
+
+void ga_histogram_print(ga_histogram *histogram, FILE *file, const char *unit)
+{
+    const unsigned int count = DEFAULT_PERCENTILES;
+    uint64_t values[DEFAULT_PERCENTILES];
+    merged *m = ga_malloc(sizeof(merged));
+    merge(histogram, m);
+    merged_percentiles(m, default_percentiles, values, count);
+    if (!unit) unit = "";
+
+    fprintf(file, "count %llu, min %llu%s, mean %.1f%s, max %llu%s\n",
+            (unsigned long long)m->count, (unsigned long long)m->min, unit,
+            m->count ? (double)m->sum / m->count : 0.0, unit, (unsigned long long)m->max, unit);
+    for (unsigned int p = 0; p < count; p++) {
+        fprintf(file, "  p%-6g %12llu%s\n", default_percentiles[p], (unsigned long long)values[p], unit);
+    }
+    ga_free(m);
+}
+
+void ga_histogram_print_json(ga_histogram *histogram, FILE *file)
+{
+    const unsigned int count = DEFAULT_PERCENTILES;
+    uint64_t values[DEFAULT_PERCENTILES];
+    merged *m = ga_malloc(sizeof(merged));
+    merge(histogram, m);
+    merged_percentiles(m, default_percentiles, values, count);
+
+    fprintf(file, "{\"count\": %llu, \"min\": %llu, \"max\": %llu, \"mean\": %.3f, \"percentiles\": {",
+            (unsigned long long)m->count, (unsigned long long)m->min, (unsigned long long)m->max,
+            m->count ? (double)m->sum / m->count : 0.0);
+    for (unsigned int p = 0; p < count; p++) {
+        fprintf(file, "%s\"%g\": %llu", p ? ", " : "", default_percentiles[p], (unsigned long long)values[p]);
+    }
+    // Non-empty buckets as [lowest value, highest value, count]
+    fprintf(file, "}, \"buckets\": [");
+    bool first = true;
+    for (unsigned int i = 0; i < GA_HISTOGRAM_BUCKETS; i++) {
+        if (!m->buckets[i]) continue;
+        fprintf(file, "%s[%llu, %llu, %llu]", first ? "" : ", ",
+                (unsigned long long)bucket_low(i), (unsigned long long)bucket_high(i), (unsigned long long)m->buckets[i]);
+        first = false;
+    }
+    fprintf(file, "]}\n");
+    ga_free(m);
+}
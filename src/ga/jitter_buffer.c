@@ -0,0 +1,177 @@
+#include "ga/jitter_buffer.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <string.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/ring_buffer.h"
+#include "ga/resampler.h"
+#include "ga/seqlock.h"
+
+// Telemetry written by the reader, published through a seqlock
+typedef struct reader_stats {
+    double      fill;
+    double      average_fill;
+    double      ratio;
+    double      ppm;
+    uint64_t    frames_read;
+    uint64_t    underruns;
+} reader_stats;
+
+struct ga_jitter_buffer {
+    unsigned int    channels;
+    size_t          frame_size;
+    double          sample_rate;
+    size_t          target;
+    ga_ring_buffer  *ring;
+    ga_resampler    *resampler;
+
+    // Reader state
+    bool            primed;             //  Filled up to the target since the last underrun
+    double          average_fill;
+    double          integral;           //  Learned drift (as a correction)
+    double          time_constant;
+    reader_stats    reader;
+    ga_seqlock      lock;
+    reader_stats    published;
+
+    // Written by the writer
+    atomic_ullong   frames_written;
+    atomic_ullong   overflows;
+};
+
+// -----------------------------------------------------------------------------
+
+ga_jitter_buffer* ga_jitter_buffer_create(unsigned int channels, double sample_rate, size_t target_frames, size_t capacity_frames, ga_resampler_quality quality)
+{
+    assert(channels > 0 && sample_rate > 0.0);
+    assert(target_frames > 0 && target_frames < capacity_frames);
+
+    double max_correction = GA_JITTER_BUFFER_MAX_PPM * 1e-6;
+    ga_jitter_buffer *buffer = ga_newc(ga_jitter_buffer);
+    buffer->channels = channels;
+    buffer->frame_size = channels * sizeof(float);
+    buffer->sample_rate = sample_rate;
+    buffer->target = target_frames;
+    buffer->ring = ga_ring_buffer_create_with_flags(capacity_frames * buffer->frame_size, GA_MEM_REALTIME);
+    buffer->resampler = ga_resampler_create(channels, quality, 1.0 / (1.0 + max_correction), 1.0 / (1.0 - max_correction));
+    buffer->time_constant = GA_JITTER_BUFFER_TIME_CONSTANT;
+    buffer->average_fill = target_frames;
+    buffer->reader.fill = 0.0;
+    buffer->reader.average_fill = target_frames;
+    buffer->reader.ratio = 1.0;
+    ga_seqlock_init(&buffer->lock);
+    buffer->published = buffer->reader;
+    return buffer;
+}
+
+void ga_jitter_buffer_destroy(ga_jitter_buffer *buffer)
+{
+    ga_resampler_destroy(buffer->resampler);
+    ga_ring_buffer_destroy(buffer->ring);
+    ga_free(buffer);
+}
+
+// Called by the reader, or before reading starts
+void ga_jitter_buffer_set_time_constant(ga_jitter_buffer *buffer, double seconds)
+{
+    assert(seconds > 0.0);
+    buffer->time_constant = seconds;
+}
+
+size_t ga_jitter_buffer_write(ga_jitter_buffer *buffer, const float *data, size_t frames)
+{
+    size_t space = ga_ring_buffer_can_write(buffer->ring) / buffer->frame_size;
+    size_t written = frames < space ? frames : space;
+    if (written) ga_ring_buffer_write(buffer->ring, written * buffer->frame_size, (void*)data);
+    if (written < frames) {
+        atomic_store_explicit(&buffer->overflows, atomic_load_explicit(&buffer->overflows, memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+    atomic_store_explicit(&buffer->frames_written, atomic_load_explicit(&buffer->frames_written, memory_order_relaxed) + written, memory_order_relaxed);
+    return written;
+}
+
+// -----------------------------------------------------------------------------
+
+static inline double fill_level(ga_jitter_buffer *buffer)
+{
+    return ga_ring_buffer_can_read(buffer->ring) / buffer->frame_size + ga_resampler_buffered(buffer->resampler);
+}
+
+// Updates the ratio from the fill level, after a block of the given length
+static void control(ga_jitter_buffer *buffer, double fill, size_t frames)
+{
+    double dt = frames / buffer->sample_rate;
+    double tau = buffer->time_constant;
+    double max_correction = GA_JITTER_BUFFER_MAX_PPM * 1e-6;
+
+    // Bursty writers make the fill level jump; smooth it faster than the loop reacts
+    double smoothing = dt / (tau / 8.0);
+    if (smoothing > 1.0) smoothing = 1.0;
+    buffer->average_fill += (fill - buffer->average_fill) * smoothing;
+
+    // The fill level integrates the ratio error, so a PI controller with the integral
+    // time at four times the proportional time constant is critically damped
+    double error = (buffer->average_fill - buffer->target) / (tau * buffer->sample_rate);
+    buffer->integral += error * dt / (4.0 * tau);
+    if (buffer->integral > max_correction) buffer->integral = max_correction;
+    if (buffer->integral < -max_correction) buffer->integral = -max_correction;
+
+    double correction = error + buffer->integral;
+    if (correction > max_correction) correction = max_correction;
+    if (correction < -max_correction) correction = -max_correction;
+
+    // Reading faster means more input frames per output frame, a lower ratio
+    ga_resampler_set_ratio(buffer->resampler, 1.0 / (1.0 + correction));
+    buffer->reader.ppm = correction * 1e6;
+}
+
+size_t ga_jitter_buffer_read(ga_jitter_buffer *buffer, float *data, size_t frames)
+{
+    size_t read = 0;
+
+    if (!buffer->primed && ga_ring_buffer_can_read(buffer->ring) / buffer->frame_size >= buffer->target) {
+        buffer->primed = true;
+        ga_resampler_reset(buffer->resampler);
+        buffer->average_fill = fill_level(buffer);
+    }
+
+    if (buffer->primed) {
+        read = ga_resampler_process(buffer->resampler, buffer->ring, data, frames);
+        if (read < frames) {
+            buffer->primed = false;
+            buffer->reader.underruns++;
+        } else {
+            control(buffer, fill_level(buffer), frames);
+        }
+    } else {
+        memset(data, 0, frames * buffer->frame_size);
+    }
+
+    buffer->reader.frames_read += read;
+    buffer->reader.fill = fill_level(buffer);
+    buffer->reader.average_fill = buffer->average_fill;
+    buffer->reader.ratio = ga_resampler_get_ratio(buffer->resampler);
+    ga_seqlock_write(&buffer->lock, &buffer->published, &buffer->reader, sizeof(reader_stats));
+    return read;
+}
+
+// -----------------------------------------------------------------------------
+
+void ga_jitter_buffer_get_stats(ga_jitter_buffer *buffer, ga_jitter_buffer_stats *stats)
+{
+    reader_stats reader;
+    ga_seqlock_read(&buffer->lock, &reader, &buffer->published, sizeof(reader_stats), GA_SEQLOCK_RETRY_FOREVER);
+    stats->fill = reader.fill;
+    stats->average_fill = reader.average_fill;
+    stats->target = buffer->target;
+    stats->ratio = reader.ratio;
+    stats->ppm = reader.ppm;
+    stats->frames_read = reader.frames_read;
+    stats->underruns = reader.underruns;
+    stats->frames_written = atomic_load_explicit(&buffer->frames_written, memory_order_relaxed);
+    stats->overflows = atomic_load_explicit(&buffer->overflows, memory_order_relaxed);
+}
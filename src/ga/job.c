@@ -0,0 +1,295 @@
+#include "ga/job.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/thread.h"
+#include "ga/eventcount.h"
+#include "config.h"
+
+#define DEQUE_SIZE GA_JOB_MAX_JOBS
+#define DEQUE_MASK (DEQUE_SIZE - 1)
+
+struct ga_job {
+    ga_job_func         func;
+    void                *data;
+    ga_job              *parent;
+    atomic_int          unfinished;             //  1 for the job itself, plus one per unfinished child
+    unsigned int        continuation_count;
+    ga_job              *continuations[GA_JOB_MAX_CONTINUATIONS];
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+typedef char cacheline_pad [CACHELINE_SIZE];
+
+// Per-thread state. Index 0 is the thread that created the system.
+typedef struct worker {
+    atomic_long         top;                    //  Stolen from here
+    cacheline_pad       pad0;
+    atomic_long         bottom;                 //  Pushed and taken here, by the owner only
+    _Atomic(ga_job*)    *deque;
+    ga_job              *jobs;                  //  Job ring
+    unsigned int        next_job;
+    uint32_t            rng;
+    unsigned int        index;
+    ga_job_system       *system;
+    ga_thread           *thread;
+    cacheline_pad       pad1;
+} worker;
+
+struct ga_job_system {
+    worker              *workers;
+    unsigned int        count;                  //  Number of workers, including the creating thread
+    atomic_uint         running;
+    ga_eventcount       idle;
+};
+
+static _Thread_local worker *tWorker = NULL;
+
+// -----------------------------------------------------------------------------
+//  Chase-Lev deque, as in "Correct and Efficient Work-Stealing for Weak
+//  Memory Models" (Lê, Pop, Cohen, Zappa Nardelli 2013), without growing.
+
+static bool deque_push(worker *w, ga_job *job)
+{
+    long b = atomic_load_explicit(&w->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&w->top, memory_order_acquire);
+    if (b - t > DEQUE_MASK) return false;
+    atomic_store_explicit(&w->deque[b & DEQUE_MASK], job, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+static ga_job* deque_take(worker *w)
+{
+    long b = atomic_load_explicit(&w->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&w->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&w->top, memory_order_relaxed);
+    ga_job *job = NULL;
+    if (t <= b) {
+        job = atomic_load_explicit(&w->deque[b & DEQUE_MASK], memory_order_relaxed);
+        if (t == b) {
+            // Last job, race against thieves
+            if (!atomic_compare_exchange_strong_explicit(&w->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+                job = NULL;
+            }
+            atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+static ga_job* deque_steal(worker *w)
+{
+    long t = atomic_load_explicit(&w->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&w->bottom, memory_order_acquire);
+    if (t >= b) return NULL;
+    ga_job *job = atomic_load_explicit(&w->deque[t & DEQUE_MASK], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&w->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return job;
+}
+
+// -----------------------------------------------------------------------------
+
+static inline uint32_t next_random(worker *w)
+{
+    // xorshift32
+    uint32_t x = w->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return w->rng = x;
+}
+
+static ga_job* get_job(worker *w)
+{
+    ga_job *job = deque_take(w);
+    if (job) return job;
+    ga_job_system *system = w->system;
+    unsigned int start = next_random(w) % system->count;
+    for (unsigned int i = 0; i < system->count; i++) {
+        worker *victim = &system->workers[(start + i) % system->count];
+        if (victim == w) continue;
+        job = deque_steal(victim);
+        if (job) return job;
+    }
+    return NULL;
+}
+
+static void execute(ga_job_system *system, ga_job *job);
+
+static void finish(ga_job_system *system, ga_job *job)
+{
+    // Once unfinished reaches zero, the owner may reuse the job, so read it first
+    ga_job *parent = job->parent;
+    unsigned int continuation_count = job->continuation_count;
+    ga_job *continuations[GA_JOB_MAX_CONTINUATIONS];
+    for (unsigned int i = 0; i < continuation_count; i++) continuations[i] = job->continuations[i];
+
+    if (atomic_fetch_sub_explicit(&job->unfinished, 1, memory_order_acq_rel) != 1) return;
+    for (unsigned int i = 0; i < continuation_count; i++) {
+        ga_job_run(system, continuations[i]);
+    }
+    if (parent) finish(system, parent);
+}
+
+static void execute(ga_job_system *system, ga_job *job)
+{
+    job->func(system, job, job->data);
+    finish(system, job);
+}
+
+static void* worker_thread(void *data)
+{
+    worker *w = data;
+    ga_job_system *system = w->system;
+    tWorker = w;
+    while (atomic_load_explicit(&system->running, memory_order_acquire)) {
+        ga_job *job = get_job(w);
+        if (job) {
+            execute(system, job);
+            continue;
+        }
+        unsigned int key = ga_eventcount_prepare(&system->idle);
+        job = get_job(w);
+        if (job) {
+            ga_eventcount_cancel(&system->idle);
+            execute(system, job);
+            continue;
+        }
+        if (!atomic_load_explicit(&system->running, memory_order_acquire)) {
+            ga_eventcount_cancel(&system->idle);
+            break;
+        }
+        ga_eventcount_wait(&system->idle, key);
+    }
+    return NULL;
+}
+
+static inline worker* current_worker(ga_job_system *system)
+{
+    worker *w = tWorker;
+    assert(w && w->system == system && "Not called from a thread of this job system");
+    return w;
+}
+
+// -----------------------------------------------------------------------------
+
+ga_job_system* ga_job_system_create(unsigned int workers)
+{
+    assert(!tWorker && "Thread already owns a job system");
+    if (!workers) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 1 ? cpus - 1 : 1;
+    }
+    ga_job_system *system = ga_newc_aligned(ga_job_system);
+    system->count = workers + 1;
+    system->workers = ga_calloc_aligned(CACHELINE_SIZE, system->count, sizeof(worker));
+    atomic_store(&system->running, 1);
+
+    for (unsigned int i = 0; i < system->count; i++) {
+        worker *w = &system->workers[i];
+        w->deque = ga_calloc_aligned(CACHELINE_SIZE, DEQUE_SIZE, sizeof(ga_job*));
+        w->jobs = ga_calloc_aligned(CACHELINE_SIZE, GA_JOB_MAX_JOBS, sizeof(ga_job));
+        w->rng = 2463534242u + i * 7919;
+        w->index = i;
+        w->system = system;
+    }
+    tWorker = &system->workers[0];
+    for (unsigned int i = 1; i < system->count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "job worker %u", i);
+        system->workers[i].thread = ga_thread_create_named(worker_thread, &system->workers[i], name);
+    }
+    return system;
+}
+
+void ga_job_system_destroy(ga_job_system *system)
+{
+    assert(current_worker(system)->index == 0 && "Must be destroyed by the thread that created it");
+    atomic_store(&system->running, 0);
+    ga_eventcount_notify(&system->idle);
+    for (unsigned int i = 1; i < system->count; i++) {
+        ga_thread_join(system->workers[i].thread);
+    }
+    for (unsigned int i = 0; i < system->count; i++) {
+        ga_free(system->workers[i].deque);
+        ga_free(system->workers[i].jobs);
+    }
+    tWorker = NULL;
+    ga_free(system->workers);
+    ga_free(system);
+}
+
+unsigned int ga_job_system_worker_count(ga_job_system *system)
+{
+    return system->count;
+}
+
+ga_job* ga_job_create(ga_job_system *system, ga_job_func func, void *data)
+{
+    return ga_job_create_child(system, NULL, func, data);
+}
+
+ga_job* ga_job_create_child(ga_job_system *system, ga_job *parent, ga_job_func func, void *data)
+{
+    worker *w = current_worker(system);
+    ga_job *job = &w->jobs[w->next_job++ % GA_JOB_MAX_JOBS];
+    if (atomic_load_explicit(&job->unfinished, memory_order_acquire) != 0) {
+        fatal_error("Too many unfinished jobs on one thread (at most %d)", GA_JOB_MAX_JOBS);
+    }
+    job->func = func;
+    job->data = data;
+    job->parent = parent;
+    job->continuation_count = 0;
+    atomic_store_explicit(&job->unfinished, 1, memory_order_relaxed);
+    if (parent) atomic_fetch_add_explicit(&parent->unfinished, 1, memory_order_relaxed);
+    return job;
+}
+
+void ga_job_add_continuation(ga_job *job, ga_job *continuation)
+{
+    assert(job->continuation_count < GA_JOB_MAX_CONTINUATIONS && "Too many continuations");
+    job->continuations[job->continuation_count++] = continuation;
+}
+
+void ga_job_run(ga_job_system *system, ga_job *job)
+{
+    worker *w = current_worker(system);
+    if (!deque_push(w, job)) {
+        // Deque full, so just do it now
+        execute(system, job);
+        return;
+    }
+    ga_eventcount_notify_one(&system->idle);
+}
+
+void ga_job_wait(ga_job_system *system, ga_job *job)
+{
+    worker *w = current_worker(system);
+    while (atomic_load_explicit(&job->unfinished, memory_order_acquire) > 0) {
+        ga_job *other = get_job(w);
+        if (other) {
+            execute(system, other);
+        } else {
+            ga_cpu_relax();
+        }
+    }
+}
+
+bool ga_job_is_finished(ga_job *job)
+{
+    return atomic_load_explicit(&job->unfinished, memory_order_acquire) == 0;
+}
@@ -0,0 +1,269 @@
+#include "ga/lock.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/futex.h"
+#include "ga/util/time.h"
+#include "config.h"
+
+// Number of attempts before a ga_spinlock parks the thread
+#define SPIN_COUNT 200
+
+// Lock statistics, written by the thread holding the lock only
+typedef struct lock_stats {
+    atomic_ullong acquires;
+    atomic_ullong contended;
+    atomic_ullong wait_ns;
+} lock_stats;
+
+struct ga_mutex {
+    pthread_mutex_t native;
+    bool stats_enabled;
+    lock_stats stats;
+};
+
+struct ga_spinlock {
+    atomic_uint state;                  //  0: unlocked, 1: locked, 2: locked with parked threads
+    bool stats_enabled;
+    lock_stats stats;
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+struct ga_cond {
+    pthread_cond_t native;
+};
+
+// -----------------------------------------------------------------------------
+
+static inline void stats_add(atomic_ullong *counter, uint64_t value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline void count_acquire(lock_stats *stats, bool contended, uint64_t wait_ns)
+{
+    stats_add(&stats->acquires, 1);
+    if (contended) {
+        stats_add(&stats->contended, 1);
+        stats_add(&stats->wait_ns, wait_ns);
+    }
+}
+
+static void get_stats(lock_stats *stats, ga_lock_stats *result)
+{
+    result->acquires  = atomic_load_explicit(&stats->acquires, memory_order_relaxed);
+    result->contended = atomic_load_explicit(&stats->contended, memory_order_relaxed);
+    result->wait_ns   = atomic_load_explicit(&stats->wait_ns, memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------
+
+ga_mutex* ga_mutex_create(bool stats)
+{
+    ga_mutex *mutex = ga_newc(ga_mutex);
+    mutex->stats_enabled = stats;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+#if defined(_POSIX_THREAD_PRIO_INHERIT) && _POSIX_THREAD_PRIO_INHERIT > 0
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+#endif
+    int result = pthread_mutex_init(&mutex->native, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    if (result != 0) {
+        fatal_error("pthread_mutex_init: %d", result);
+    }
+    return mutex;
+}
+
+void ga_mutex_destroy(ga_mutex *mutex)
+{
+    int result = pthread_mutex_destroy(&mutex->native);
+    if (result != 0) {
+        fatal_error("pthread_mutex_destroy: %d", result);
+    }
+    ga_free(mutex);
+}
+
+void ga_mutex_lock(ga_mutex *mutex)
+{
+    if (!mutex->stats_enabled) {
+        int result = pthread_mutex_lock(&mutex->native);
+        if (result != 0) fatal_error("pthread_mutex_lock: %d", result);
+        return;
+    }
+    if (pthread_mutex_trylock(&mutex->native) == 0) {
+        count_acquire(&mutex->stats, false, 0);
+        return;
+    }
+    uint64_t start = ga_now_ns();
+    int result = pthread_mutex_lock(&mutex->native);
+    if (result != 0) fatal_error("pthread_mutex_lock: %d", result);
+    count_acquire(&mutex->stats, true, ga_now_ns() - start);
+}
+
+bool ga_mutex_try_lock(ga_mutex *mutex)
+{
+    int result = pthread_mutex_trylock(&mutex->native);
+
+    switch (result) {
+    case 0:
+        if (mutex->stats_enabled) count_acquire(&mutex->stats, false, 0);
+        return true;
+    case EBUSY:
+        return false;
+    default:
+        fatal_error("pthread_mutex_trylock: %d", result);
+    }
+}
+
+void ga_mutex_unlock(ga_mutex *mutex)
+{
+    int result = pthread_mutex_unlock(&mutex->native);
+    if (result != 0) fatal_error("pthread_mutex_unlock: %d", result);
+}
+
+void ga_mutex_get_stats(ga_mutex *mutex, ga_lock_stats *stats)
+{
+    get_stats(&mutex->stats, stats);
+}
+
+// -----------------------------------------------------------------------------
+//  Three state futex lock, see "Futexes Are Tricky" (Drepper), with spinning
+
+ga_spinlock* ga_spinlock_create(bool stats)
+{
+    ga_spinlock *lock = ga_newc_aligned(ga_spinlock);
+    lock->stats_enabled = stats;
+    return lock;
+}
+
+void ga_spinlock_destroy(ga_spinlock *lock)
+{
+    assert(!atomic_load(&lock->state) && "Destroying a locked spinlock");
+    ga_free(lock);
+}
+
+bool ga_spinlock_try_lock(ga_spinlock *lock)
+{
+    unsigned int expected = 0;
+    if (atomic_compare_exchange_strong_explicit(&lock->state, &expected, 1, memory_order_acquire, memory_order_relaxed)) {
+        if (lock->stats_enabled) count_acquire(&lock->stats, false, 0);
+        return true;
+    }
+    return false;
+}
+
+void ga_spinlock_lock(ga_spinlock *lock)
+{
+    unsigned int expected = 0;
+    if (atomic_compare_exchange_strong_explicit(&lock->state, &expected, 1, memory_order_acquire, memory_order_relaxed)) {
+        if (lock->stats_enabled) count_acquire(&lock->stats, false, 0);
+        return;
+    }
+
+    uint64_t start = lock->stats_enabled ? ga_now_ns() : 0;
+    for (int i = 0; i < SPIN_COUNT; i++) {
+        ga_cpu_relax();
+        expected = 0;
+        if (atomic_load_explicit(&lock->state, memory_order_relaxed) == 0
+                && atomic_compare_exchange_weak_explicit(&lock->state, &expected, 1, memory_order_acquire, memory_order_relaxed)) {
+            goto acquired;
+        }
+    }
+    // Park. Mark the lock as having parked threads, since we can't know
+    // if we're the only one.
+    while (atomic_exchange_explicit(&lock->state, 2, memory_order_acquire) != 0) {
+        ga_futex_wait(&lock->state, 2, GA_FUTEX_FOREVER);
+    }
+
+acquired:
+    if (lock->stats_enabled) count_acquire(&lock->stats, true, ga_now_ns() - start);
+}
+
+void ga_spinlock_unlock(ga_spinlock *lock)
+{
+    if (atomic_fetch_sub_explicit(&lock->state, 1, memory_order_release) != 1) {
+        atomic_store_explicit(&lock->state, 0, memory_order_release);
+        ga_futex_wake(&lock->state, 1);
+    }
+}
+
+void ga_spinlock_get_stats(ga_spinlock *lock, ga_lock_stats *stats)
+{
+    get_stats(&lock->stats, stats);
+}
+
+// -----------------------------------------------------------------------------
+
+ga_cond* ga_cond_create()
+{
+    ga_cond *cond = ga_new(ga_cond);
+#if MACOSX
+    // No pthread_condattr_setclock, see ga_cond_timed_wait
+    int result = pthread_cond_init(&cond->native, NULL);
+#else
+    // Time out on the monotonic clock, so that setting the system time doesn't affect waits
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int result = pthread_cond_init(&cond->native, &attr);
+    pthread_condattr_destroy(&attr);
+#endif
+    if (result != 0) fatal_error("pthread_cond_init: %d", result);
+    return cond;
+}
+
+void ga_cond_destroy(ga_cond *cond)
+{
+    int result = pthread_cond_destroy(&cond->native);
+    if (result != 0) fatal_error("pthread_cond_destroy: %d", result);
+    ga_free(cond);
+}
+
+void ga_cond_wait(ga_cond *cond, ga_mutex *mutex)
+{
+    int result = pthread_cond_wait(&cond->native, &mutex->native);
+    if (result != 0) fatal_error("pthread_cond_wait: %d", result);
+}
+
+bool ga_cond_timed_wait(ga_cond *cond, ga_mutex *mutex, unsigned int ms)
+{
+#if MACOSX
+    // A relative timeout, which isn't affected by changes to the system time either
+    struct timespec timeout = { ms / 1000, (ms % 1000) * 1000000l };
+    int result = pthread_cond_timedwait_relative_np(&cond->native, &mutex->native, &timeout);
+#else
+    // pthread_cond_timedwait takes an absolute deadline, on the clock set in ga_cond_create
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (ms % 1000) * 1000000l;
+    if (deadline.tv_nsec >= 1000000000l) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000l;
+    }
+    int result = pthread_cond_timedwait(&cond->native, &mutex->native, &deadline);
+#endif
+    if (result == ETIMEDOUT) return false;
+    if (result != 0) fatal_error("pthread_cond_timedwait: %d", result);
+    return true;
+}
+
+void ga_cond_signal(ga_cond *cond)
+{
+    pthread_cond_signal(&cond->native);
+}
+
+void ga_cond_broadcast(ga_cond *cond)
+{
+    pthread_cond_broadcast(&cond->native);
+}
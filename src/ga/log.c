@@ -0,0 +1,514 @@
+#include "ga/log.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/thread.h"
+#include "ga/lock.h"
+#include "ga/ring_buffer.h"
+#include "ga/realtime.h"
+#include "ga/util/time.h"
+#include "config.h"
+
+#define MAX_RECORD      1024
+#define MAX_LINE        1024
+#define NAME_SIZE       32
+
+typedef struct record_header {
+    uint64_t            time;
+    const char          *format;
+    uint16_t            size;           //  Including the header, a multiple of 8
+    uint8_t             level;
+    uint8_t             arg_count;
+    uint32_t            reserved;
+} record_header;
+
+// Arguments follow the header, one 64 bit slot each (a string slot holds
+// the offset of a length byte and the characters, stored after the slots)
+typedef union slot {
+    int64_t             i;
+    uint64_t            u;
+    double              d;
+    const void          *p;
+} slot;
+
+typedef struct log_buffer log_buffer;
+struct log_buffer {
+    ga_ring_buffer      *ring;
+    atomic_ullong       dropped;        //  Written by the owning thread only
+    atomic_uint         used;           //  Owned by a live thread
+    unsigned int        id;
+    char                name[NAME_SIZE];
+    log_buffer          *next;
+};
+
+typedef enum length_modifier { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_J, LEN_Z, LEN_T, LEN_BIG_L } length_modifier;
+
+typedef struct spec {
+    const char          *start;         //  The '%'
+    const char          *length;        //  The length modifier, if any, else the conversion
+    length_modifier     modifier;
+    int                 stars;          //  Width and precision given as arguments
+    char                conversion;
+} spec;
+
+atomic_int ga_log_level = GA_LOG_INFO;
+
+static _Atomic(log_buffer*) gBuffers;       //  All buffers, never unlinked (reused after thread exit)
+static atomic_uint gNextId;
+static atomic_ullong gUnbufferedDrops;        //  Dropped because a realtime section would have to allocate or write
+static pthread_key_t gExitKey;
+static pthread_once_t gExitKeyOnce = PTHREAD_ONCE_INIT;
+static _Thread_local log_buffer *tBuffer;
+static _Thread_local bool tCreating;        //  In local_buffer, creating tBuffer (which can log itself)
+static _Thread_local char tName[NAME_SIZE];
+
+static ga_thread *gWriter;
+static ga_mutex *gDrainMutex;
+static atomic_uint gRunning;
+static unsigned int gInterval;
+static FILE *gFile;
+static uint64_t gStartTime;
+static uint64_t gReportedDrops;
+
+static const char *level_names[] = { "", "ERROR", "WARNING", "INFO", "DEBUG" };
+
+// -----------------------------------------------------------------------------
+
+// Parses the conversion specification at p (a '%'), returns false if malformed
+static bool parse_spec(const char *p, spec *s)
+{
+    s->start = p++;
+    s->stars = 0;
+    while (*p && strchr("-+ #0'", *p)) p++;
+    if (*p == '*') {
+        s->stars++;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            s->stars++;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') p++;
+        }
+    }
+    s->length = p;
+    switch (*p) {
+    case 'h': s->modifier = p[1] == 'h' ? LEN_HH : LEN_H; p += p[1] == 'h' ? 2 : 1; break;
+    case 'l': s->modifier = p[1] == 'l' ? LEN_LL : LEN_L; p += p[1] == 'l' ? 2 : 1; break;
+    case 'q': s->modifier = LEN_LL; p++; break;
+    case 'j': s->modifier = LEN_J; p++; break;
+    case 'z': s->modifier = LEN_Z; p++; break;
+    case 't': s->modifier = LEN_T; p++; break;
+    case 'L': s->modifier = LEN_BIG_L; p++; break;
+    default:  s->modifier = LEN_NONE; break;
+    }
+    s->conversion = *p;
+    return *p && strchr("diouxXcCeEfFgGaAspn", *p);
+}
+
+static inline const char* spec_end(const spec *s)
+{
+    const char *p = s->length;
+    while (*p != s->conversion) p++;
+    return p + 1;
+}
+
+// -----------------------------------------------------------------------------
+
+static void release_buffer(void *data)
+{
+    log_buffer *buffer = data;
+    atomic_store_explicit(&buffer->used, 0, memory_order_release);
+}
+
+static void create_exit_key()
+{
+    pthread_key_create(&gExitKey, release_buffer);
+}
+
+static log_buffer* local_buffer()
+{
+    if (tBuffer) return tBuffer;
+    pthread_once(&gExitKeyOnce, create_exit_key);
+
+    log_buffer *buffer = NULL;
+    // Reuse the buffer of an exited thread, once it has been emptied
+    for (log_buffer *b = atomic_load_explicit(&gBuffers, memory_order_acquire); b; b = b->next) {
+        unsigned int expected = 0;
+        if (!atomic_load_explicit(&b->used, memory_order_relaxed)
+                && !ga_ring_buffer_can_read(b->ring)
+                && atomic_compare_exchange_strong(&b->used, &expected, 1)) {
+            buffer = b;
+            break;
+        }
+    }
+    if (!buffer) {
+        tCreating = true;
+        buffer = ga_newc_aligned(log_buffer);
+        buffer->ring = ga_ring_buffer_create_with_flags(GA_LOG_BUFFER_SIZE, GA_MEM_REALTIME);
+        tCreating = false;
+        buffer->id = atomic_fetch_add(&gNextId, 1) + 1;
+        atomic_init(&buffer->used, 1);
+
+        log_buffer *head = atomic_load_explicit(&gBuffers, memory_order_relaxed);
+        do {
+            buffer->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&gBuffers, &head, buffer, memory_order_release, memory_order_relaxed));
+    }
+    // The name is only read by the writer thread once messages have been written
+    memcpy(buffer->name, tName, NAME_SIZE);
+    pthread_setspecific(gExitKey, buffer);
+    tBuffer = buffer;
+    return buffer;
+}
+
+void ga_log_set_thread_name(const char *name)
+{
+    tName[0] = '\0';
+    if (name) strncat(tName, name, NAME_SIZE - 1);
+    if (tBuffer) memcpy(tBuffer->name, tName, NAME_SIZE);
+}
+
+void ga_log_register_thread(const char *name)
+{
+    ga_log_set_thread_name(name);
+    local_buffer();
+}
+
+// -----------------------------------------------------------------------------
+
+// Copies the arguments into a record, returns its size
+static size_t make_record(uint8_t *record, int level, const char *format, va_list args)
+{
+    record_header *header = (record_header*)record;
+    slot *slots = (slot*)(record + sizeof(record_header));
+    size_t strings = sizeof(record_header) + GA_LOG_MAX_ARGS * sizeof(slot);
+    unsigned int count = 0;
+
+    for (const char *p = format; *p && count < GA_LOG_MAX_ARGS; p++) {
+        if (*p != '%') continue;
+        if (p[1] == '%') {
+            p++;
+            continue;
+        }
+        spec s;
+        if (!parse_spec(p, &s)) break;
+        for (int i = 0; i < s.stars && count < GA_LOG_MAX_ARGS; i++) {
+            slots[count++].i = va_arg(args, int);
+        }
+        if (count == GA_LOG_MAX_ARGS) break;
+
+        slot *arg = &slots[count++];
+        switch (s.conversion) {
+        case 'd': case 'i':
+            switch (s.modifier) {
+            case LEN_HH: arg->i = (signed char)va_arg(args, int); break;
+            case LEN_H:  arg->i = (short)va_arg(args, int); break;
+            case LEN_L:  arg->i = va_arg(args, long); break;
+            case LEN_LL: arg->i = va_arg(args, long long); break;
+            case LEN_J:  arg->i = va_arg(args, intmax_t); break;
+            case LEN_Z:  arg->i = (int64_t)va_arg(args, size_t); break;
+            case LEN_T:  arg->i = va_arg(args, ptrdiff_t); break;
+            default:     arg->i = va_arg(args, int); break;
+            }
+            break;
+        case 'o': case 'u': case 'x': case 'X':
+            switch (s.modifier) {
+            case LEN_HH: arg->u = (unsigned char)va_arg(args, unsigned int); break;
+            case LEN_H:  arg->u = (unsigned short)va_arg(args, unsigned int); break;
+            case LEN_L:  arg->u = va_arg(args, unsigned long); break;
+            case LEN_LL: arg->u = va_arg(args, unsigned long long); break;
+            case LEN_J:  arg->u = va_arg(args, uintmax_t); break;
+            case LEN_Z:  arg->u = va_arg(args, size_t); break;
+            case LEN_T:  arg->u = (uint64_t)va_arg(args, ptrdiff_t); break;
+            default:     arg->u = va_arg(args, unsigned int); break;
+            }
+            break;
+        case 'c': case 'C':
+            arg->i = va_arg(args, int);
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            arg->d = s.modifier == LEN_BIG_L ? (double)va_arg(args, long double) : va_arg(args, double);
+            break;
+        case 's': {
+            const char *string = va_arg(args, const char*);
+            if (!string) {
+                arg->u = 0;
+                break;
+            }
+            size_t length = strnlen(string, GA_LOG_MAX_STRING);
+            record[strings] = length;
+            memcpy(record + strings + 1, string, length);
+            arg->u = strings;
+            strings += length + 1;
+            break;
+        }
+        case 'p':
+            arg->p = va_arg(args, void*);
+            break;
+        case 'n':
+            va_arg(args, void*);
+            count--;
+            break;
+        }
+        p = spec_end(&s) - 1;
+    }
+
+    header->time = ga_now_ns();
+    header->format = format;
+    header->level = level;
+    header->arg_count = count;
+    header->size = (strings + 7) & ~(size_t)7;
+    return header->size;
+}
+
+// Formats a record into line, returns the length
+static size_t format_record(const uint8_t *record, char *line, size_t size)
+{
+    const record_header *header = (const record_header*)record;
+    const slot *slots = (const slot*)(record + sizeof(record_header));
+    unsigned int next = 0;
+    size_t n = 0;
+
+#define APPEND(...) do { \
+        int written = snprintf(line + n, size - n, __VA_ARGS__); \
+        if (written > 0) n = n + written < size ? n + written : size - 1; \
+    } while (0)
+
+    for (const char *p = header->format; *p && n < size - 1; p++) {
+        if (*p != '%') {
+            line[n++] = *p;
+            continue;
+        }
+        if (p[1] == '%') {
+            line[n++] = '%';
+            p++;
+            continue;
+        }
+        spec s;
+        if (!parse_spec(p, &s) || next + s.stars + (s.conversion != 'n') > header->arg_count) {
+            APPEND("%s", "...");
+            break;
+        }
+
+        // Rebuild the specification with the stars filled in, and 64 bit arguments
+        char conversion[64];
+        size_t c = 0;
+        for (const char *q = s.start; q < s.length && c < sizeof(conversion) - 24; q++) {
+            if (*q == '*') {
+                c += snprintf(conversion + c, sizeof(conversion) - c, "%d", (int)slots[next++].i);
+            } else {
+                conversion[c++] = *q;
+            }
+        }
+        conversion[c] = '\0';
+        const slot *arg = &slots[next];
+
+        switch (s.conversion) {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+            strcat(conversion, "ll");
+            conversion[c + 2] = s.conversion;
+            conversion[c + 3] = '\0';
+            if (s.conversion == 'd' || s.conversion == 'i') {
+                APPEND(conversion, (long long)arg->i);
+            } else {
+                APPEND(conversion, (unsigned long long)arg->u);
+            }
+            next++;
+            break;
+        case 'c': case 'C':
+            conversion[c] = 'c';
+            conversion[c + 1] = '\0';
+            APPEND(conversion, (int)arg->i);
+            next++;
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            conversion[c] = s.conversion;
+            conversion[c + 1] = '\0';
+            APPEND(conversion, arg->d);
+            next++;
+            break;
+        case 's': {
+            char string[GA_LOG_MAX_STRING + 1];
+            if (arg->u) {
+                uint8_t length = record[arg->u];
+                memcpy(string, record + arg->u + 1, length);
+                string[length] = '\0';
+            } else {
+                strcpy(string, "(null)");
+            }
+            conversion[c] = 's';
+            conversion[c + 1] = '\0';
+            APPEND(conversion, string);
+            next++;
+            break;
+        }
+        case 'p':
+            conversion[c] = 'p';
+            conversion[c + 1] = '\0';
+            APPEND(conversion, arg->p);
+            next++;
+            break;
+        }
+        p = spec_end(&s) - 1;
+    }
+#undef APPEND
+
+    line[n] = '\0';
+    return n;
+}
+
+static void write_record(const uint8_t *record, const char *name, unsigned int id)
+{
+    const record_header *header = (const record_header*)record;
+    char message[MAX_LINE];
+    format_record(record, message, sizeof(message));
+
+    double seconds = (header->time - gStartTime) / 1e9;
+    if (name && name[0]) {
+        fprintf(gFile, "%12.6f %-7s [%s] %s\n", seconds, level_names[header->level], name, message);
+    } else if (!id) {
+        fprintf(gFile, "%12.6f %-7s %s\n", seconds, level_names[header->level], message);
+    } else {
+        fprintf(gFile, "%12.6f %-7s [thread %u] %s\n", seconds, level_names[header->level], id, message);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+static uint64_t total_dropped()
+{
+    uint64_t dropped = atomic_load_explicit(&gUnbufferedDrops, memory_order_relaxed);
+    for (log_buffer *buffer = atomic_load_explicit(&gBuffers, memory_order_acquire); buffer; buffer = buffer->next) {
+        dropped += atomic_load_explicit(&buffer->dropped, memory_order_relaxed);
+    }
+    return dropped;
+}
+
+static void drain()
+{
+    uint8_t record[MAX_RECORD];
+
+    ga_mutex_lock(gDrainMutex);
+    for (log_buffer *buffer = atomic_load_explicit(&gBuffers, memory_order_acquire); buffer; buffer = buffer->next) {
+        while (ga_ring_buffer_can_read(buffer->ring) >= sizeof(record_header)) {
+            ga_ring_buffer_read_atomic(buffer->ring, sizeof(record_header), record);
+            record_header *header = (record_header*)record;
+            ga_ring_buffer_read_atomic(buffer->ring, header->size - sizeof(record_header), record + sizeof(record_header));
+            write_record(record, buffer->name, buffer->id);
+        }
+    }
+    uint64_t dropped = total_dropped();
+    if (dropped != gReportedDrops) {
+        fprintf(gFile, "%12.6f %-7s %llu log messages dropped\n", (ga_now_ns() - gStartTime) / 1e9,
+                level_names[GA_LOG_WARNING], (unsigned long long)(dropped - gReportedDrops));
+        gReportedDrops = dropped;
+    }
+    fflush(gFile);
+    ga_mutex_unlock(gDrainMutex);
+}
+
+static void* writer_thread(void *data)
+{
+    while (atomic_load_explicit(&gRunning, memory_order_acquire)) {
+        ga_thread_sleep(gInterval);
+        drain();
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+void ga_log_write(int level, const char *format, ...)
+{
+    uint8_t record[MAX_RECORD];
+    va_list args;
+    va_start(args, format);
+    size_t size = make_record(record, level, format, args);
+    va_end(args);
+
+    if (!atomic_load_explicit(&gRunning, memory_order_acquire)) {
+        // No writer thread, so write it right away, unless that would block a realtime thread
+        if (ga_realtime_is_active()) {
+            atomic_fetch_add_explicit(&gUnbufferedDrops, 1, memory_order_relaxed);
+            return;
+        }
+        if (!gFile) gFile = stderr;
+        if (!gStartTime) gStartTime = ((record_header*)record)->time;
+        write_record(record, tName, tBuffer ? tBuffer->id : 0);
+        return;
+    }
+
+    if (!tBuffer && ga_realtime_is_active()) {
+        atomic_fetch_add_explicit(&gUnbufferedDrops, 1, memory_order_relaxed);
+        return;
+    }
+    if (tCreating) {
+        // Logged while allocating this thread's buffer (e.g. mlock failing), so there is none yet
+        ga_mutex_lock(gDrainMutex);
+        write_record(record, tName, 0);
+        ga_mutex_unlock(gDrainMutex);
+        return;
+    }
+    log_buffer *buffer = local_buffer();
+    if (!ga_ring_buffer_write_atomic(buffer->ring, size, record)) {
+        atomic_store_explicit(&buffer->dropped, atomic_load_explicit(&buffer->dropped, memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+}
+
+bool ga_log_start(FILE *file, unsigned int interval_ms)
+{
+    assert(!gWriter && "Log already started");
+    gFile = file ? file : stderr;
+    if (!gStartTime) gStartTime = ga_now_ns();
+    if (!gDrainMutex) gDrainMutex = ga_mutex_create(false);
+    gInterval = interval_ms ? interval_ms : 1;
+    gReportedDrops = total_dropped();
+
+    atomic_store(&gRunning, 1);
+    gWriter = ga_thread_create(writer_thread, NULL);
+    return gWriter != NULL;
+}
+
+void ga_log_stop()
+{
+    if (!gWriter) return;
+    atomic_store(&gRunning, 0);
+    ga_thread_join(gWriter);
+    gWriter = NULL;
+    drain();
+}
+
+void ga_log_flush()
+{
+    if (gWriter) drain();
+}
+
+void ga_log_set_level(int level)
+{
+    atomic_store_explicit(&ga_log_level, level, memory_order_relaxed);
+}
+
+int ga_log_get_level()
+{
+    return atomic_load_explicit(&ga_log_level, memory_order_relaxed);
+}
+
+uint64_t ga_log_dropped()
+{
+    return total_dropped();
+}
@@ -0,0 +1,262 @@
+
+/*
+    gaudiamus
+
+ */
+
+#include "config.h"
+
+#if LINUX
+
+#define _GNU_SOURCE
+
+#include <ga/thread.h>
+#include <ga/util.h>
+#include <ga/alloc.h>
+#include <ga/realtime.h>
+#include <ga/log.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <limits.h>
+#include <alloca.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+// Stack left untouched by the prefaulting, for the frames below the thread function
+#define PREFAULT_MARGIN (32 * 1024)
+#define PAGE_SIZE_GUESS 4096
+
+struct ga_thread {
+    pthread_t native;
+    char *name;
+    ga_thread_policy policy;
+    int priority;
+};
+
+typedef struct start_info {
+    ga_thread_func func;
+    void *data;
+    size_t prefault;                // Bytes of stack to prefault
+    char name[16];                  // OS thread name (truncated)
+} start_info;
+
+static pthread_t main_thread;
+static bool main_thread_set = false;
+
+// --------------------------------------------------------------------------------
+
+void ga_thread_initialize()
+{
+    main_thread = pthread_self();
+    main_thread_set = true;
+}
+
+void ga_thread_terminate()
+{
+    main_thread_set = false;
+}
+
+// --------------------------------------------------------------------------------
+
+static void __attribute__((noinline)) prefault_stack(size_t size)
+{
+    volatile char *stack = alloca(size);
+    for (size_t i = 0; i < size; i += PAGE_SIZE_GUESS) {
+        stack[i] = 0;
+    }
+}
+
+static void* trampoline(void *data)
+{
+    start_info info = *(start_info*)data;
+    ga_free(data);
+    if (info.name[0]) {
+        pthread_setname_np(pthread_self(), info.name);
+        ga_log_set_thread_name(info.name);
+    }
+    if (info.prefault) prefault_stack(info.prefault);
+    return info.func(info.data);
+}
+
+static int native_policy(ga_thread_policy policy)
+{
+    switch (policy) {
+    case GA_THREAD_POLICY_FIFO: return SCHED_FIFO;
+    case GA_THREAD_POLICY_RR:   return SCHED_RR;
+    default:                    return SCHED_OTHER;
+    }
+}
+
+ga_thread* ga_thread_create(ga_thread_func func, void* data)
+{
+    return ga_thread_create_named(func, data, NULL);
+}
+
+ga_thread* ga_thread_create_named(ga_thread_func func, void* data, const char *name)
+{
+    ga_thread_attr attr = GA_THREAD_ATTR_DEFAULT;
+    attr.name = name;
+    return ga_thread_create_with_attr(func, data, &attr);
+}
+
+ga_thread* ga_thread_create_with_attr(ga_thread_func func, void* data, const ga_thread_attr *attr)
+{
+    ga_realtime_check("ga_thread_create");
+    ga_thread* thread = ga_malloc_tagged(sizeof(ga_thread), GA_ALLOC_TAG_THREAD);
+    thread->name = attr->name ? strdup(attr->name) : NULL;
+
+    pthread_attr_t native_attr;
+    pthread_attr_init(&native_attr);
+
+    size_t stack_size = attr->stack_size;
+    if (stack_size) {
+        if (stack_size < PTHREAD_STACK_MIN) stack_size = PTHREAD_STACK_MIN;
+        pthread_attr_setstacksize(&native_attr, stack_size);
+    } else {
+        pthread_attr_getstacksize(&native_attr, &stack_size);
+    }
+
+    bool has_affinity = !ga_cpu_set_is_empty(&attr->affinity);
+    if (has_affinity) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int i = 0; i < GA_MAX_CPUS && i < CPU_SETSIZE; i++) {
+            if (ga_cpu_set_has(&attr->affinity, i)) CPU_SET(i, &cpus);
+        }
+        pthread_attr_setaffinity_np(&native_attr, sizeof(cpus), &cpus);
+    }
+
+    bool realtime = attr->policy == GA_THREAD_POLICY_FIFO || attr->policy == GA_THREAD_POLICY_RR;
+    bool idle = attr->policy == GA_THREAD_POLICY_IDLE;
+    if (realtime && (attr->priority < sched_get_priority_min(native_policy(attr->policy))
+            || attr->priority > sched_get_priority_max(native_policy(attr->policy)))) {
+        // Caught here, since pthread_create would fail with EINVAL, like for a bad affinity
+        ga_log_warning("Realtime priority %d not valid for thread '%s', using default policy",
+               attr->priority, attr->name ? attr->name : "<unnamed>");
+        realtime = false;
+    }
+    if (realtime) {
+        struct sched_param param = { .sched_priority = attr->priority };
+        pthread_attr_setinheritsched(&native_attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&native_attr, native_policy(attr->policy));
+        pthread_attr_setschedparam(&native_attr, &param);
+    }
+
+    start_info *info = ga_new(start_info);
+    info->func = func;
+    info->data = data;
+    info->prefault = (attr->prefault_stack && stack_size > PREFAULT_MARGIN) ? stack_size - PREFAULT_MARGIN : 0;
+    info->name[0] = '\0';
+    if (attr->name) strncat(info->name, attr->name, sizeof(info->name) - 1);
+
+    // Drop what isn't permitted or valid, one thing at a time, until the thread starts
+    int result;
+    while ((result = pthread_create(&thread->native, &native_attr, trampoline, info)) != 0) {
+        if (has_affinity && result == EINVAL) {
+            ga_log_warning("Invalid CPU affinity for thread '%s', ignoring it",
+                   attr->name ? attr->name : "<unnamed>");
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            for (int i = 0; i < CPU_SETSIZE; i++) CPU_SET(i, &cpus);
+            pthread_attr_setaffinity_np(&native_attr, sizeof(cpus), &cpus);
+            has_affinity = false;
+        } else if (realtime && result == EPERM) {
+            ga_log_warning("Realtime priority not permitted for thread '%s', using default policy",
+                   attr->name ? attr->name : "<unnamed>");
+            pthread_attr_setinheritsched(&native_attr, PTHREAD_INHERIT_SCHED);
+            realtime = false;
+        } else {
+            break;
+        }
+    }
+    pthread_attr_destroy(&native_attr);
+
+    if (result != 0) {
+        fatal_error("Couldn't spawn thread! %d", result);
+    }
+
+    // pthread_attr_setschedpolicy only takes the POSIX policies, so SCHED_IDLE is set afterwards
+    // (ESRCH: the thread is already done)
+    if (idle) {
+        struct sched_param param = { .sched_priority = 0 };
+        result = pthread_setschedparam(thread->native, SCHED_IDLE, &param);
+        if (result != 0 && result != ESRCH) {
+            ga_log_warning("Idle policy not permitted for thread '%s', using default policy",
+                   attr->name ? attr->name : "<unnamed>");
+            idle = false;
+        }
+    }
+
+    // With PTHREAD_EXPLICIT_SCHED, pthread_create fails unless the policy could be applied
+    thread->policy = (realtime || idle) ? attr->policy : GA_THREAD_POLICY_DEFAULT;
+    thread->priority = realtime ? attr->priority : 0;
+
+    if (attr->name) {
+        ga_log_debug("New thread %p '%s'", &thread->native, attr->name);
+    }
+
+    return thread;
+}
+
+ga_thread_policy ga_thread_get_policy(ga_thread *thread)
+{
+    return thread->policy;
+}
+
+int ga_thread_get_priority(ga_thread *thread)
+{
+    return thread->priority;
+}
+
+void ga_thread_sleep(unsigned int ms)
+{
+    usleep(ms * 1000);
+}
+
+void* ga_thread_join(ga_thread *thread)
+{
+    void* return_value;
+    int result = pthread_join(thread->native, &return_value);
+
+    if (result != 0) {
+        fatal_error("pthread_join: %d for thread %s", result, thread->name ? thread->name : "<unnamed>");
+    }
+    if (thread->name) {
+        ga_log_debug("Joined thread %p '%s', return value: %p", (void*)thread->native, thread->name, return_value);
+        free(thread->name);
+    }
+    ga_free(thread);
+    return return_value;
+}
+
+void ga_thread_detach(ga_thread *thread)
+{
+    int result = pthread_detach(thread->native);
+
+    if (result != 0) {
+        fatal_error("pthread_detach: %d for thread %s", result, thread->name ? thread->name : "<unnamed>");
+    }
+    if (thread->name) {
+        ga_log_debug("Detached thread %p '%s'", (void*)thread->native, thread->name);
+        free(thread->name);
+    }
+
+    ga_free(thread);
+}
+
+bool ga_thread_is_main(ga_thread *thread)
+{
+    assert(main_thread_set && "Module not initialized");
+    return pthread_equal(thread->native, main_thread);
+}
+
+bool ga_thread_is_current(ga_thread *thread)
+{
+    return pthread_equal(thread->native, pthread_self());
+}
+
+#endif
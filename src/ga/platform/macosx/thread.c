@@ -11,22 +11,37 @@
 #include <ga/thread.h>
 #include <ga/util.h>
 #include <ga/alloc.h>
+#include <ga/realtime.h>
+#include <ga/log.h>
 
 #include <pthread.h>
+#include <sched.h>
+#include <limits.h>
+#include <alloca.h>
 #include <unistd.h>
+#include <errno.h>
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
 
 
+// Stack left untouched by the prefaulting, for the frames below the thread function
+#define PREFAULT_MARGIN (32 * 1024)
+#define PAGE_SIZE_GUESS 4096
+
 struct ga_thread {
     pthread_t native;
     char *name;
+    ga_thread_policy policy;
+    int priority;
 };
 
-struct ga_mutex {
-    pthread_mutex_t native;
-};
+typedef struct start_info {
+    ga_thread_func func;
+    void *data;
+    size_t prefault;                // Bytes of stack to prefault
+    char *name;                     // Set from the thread itself
+} start_info;
 
 static pthread_t main_thread = NULL;
 
@@ -51,22 +66,125 @@ ga_thread* ga_thread_create(ga_thread_func func, void* data)
 
 ga_thread* ga_thread_create_named(ga_thread_func func, void* data, const char *name)
 {
-    ga_thread* thread = ga_new(ga_thread);
-    thread->name = name ? strdup(name) : NULL;
+    ga_thread_attr attr = GA_THREAD_ATTR_DEFAULT;
+    attr.name = name;
+    return ga_thread_create_with_attr(func, data, &attr);
+}
 
-    int result = pthread_create(&thread->native, NULL, func, data);
+static void __attribute__((noinline)) prefault_stack(size_t size)
+{
+    volatile char *stack = alloca(size);
+    for (size_t i = 0; i < size; i += PAGE_SIZE_GUESS) {
+        stack[i] = 0;
+    }
+}
+
+static void* trampoline(void *data)
+{
+    start_info info = *(start_info*)data;
+    ga_free(data);
+    // Mac OS X can only set the name of the current thread
+    if (info.name) {
+        pthread_setname_np(info.name);
+        ga_log_set_thread_name(info.name);
+        free(info.name);
+    }
+    if (info.prefault) prefault_stack(info.prefault);
+    return info.func(info.data);
+}
+
+static int native_policy(ga_thread_policy policy)
+{
+    switch (policy) {
+    case GA_THREAD_POLICY_FIFO: return SCHED_FIFO;
+    case GA_THREAD_POLICY_RR:   return SCHED_RR;
+    default:                    return SCHED_OTHER;
+    }
+}
+
+// Thread affinity is not supported on Mac OS X, so attr->affinity is ignored
+ga_thread* ga_thread_create_with_attr(ga_thread_func func, void* data, const ga_thread_attr *attr)
+{
+    ga_realtime_check("ga_thread_create");
+    ga_thread* thread = ga_malloc_tagged(sizeof(ga_thread), GA_ALLOC_TAG_THREAD);
+    thread->name = attr->name ? strdup(attr->name) : NULL;
+
+    pthread_attr_t native_attr;
+    pthread_attr_init(&native_attr);
+
+    size_t stack_size = attr->stack_size;
+    if (stack_size) {
+        if (stack_size < PTHREAD_STACK_MIN) stack_size = PTHREAD_STACK_MIN;
+        pthread_attr_setstacksize(&native_attr, stack_size);
+    } else {
+        pthread_attr_getstacksize(&native_attr, &stack_size);
+    }
+
+    bool realtime = attr->policy == GA_THREAD_POLICY_FIFO || attr->policy == GA_THREAD_POLICY_RR;
+    bool idle = attr->policy == GA_THREAD_POLICY_IDLE;
+    if (realtime && (attr->priority < sched_get_priority_min(native_policy(attr->policy))
+            || attr->priority > sched_get_priority_max(native_policy(attr->policy)))) {
+        // Caught here, since pthread_create would fail with EINVAL
+        ga_log_warning("Realtime priority %d not valid for thread '%s', using default policy",
+               attr->priority, attr->name ? attr->name : "<unnamed>");
+        realtime = false;
+    }
+    if (realtime) {
+        struct sched_param param = { .sched_priority = attr->priority };
+        pthread_attr_setinheritsched(&native_attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&native_attr, native_policy(attr->policy));
+        pthread_attr_setschedparam(&native_attr, &param);
+    } else if (idle) {
+        // There is no SCHED_IDLE, the lowest SCHED_OTHER priority is the closest
+        struct sched_param param = { .sched_priority = sched_get_priority_min(SCHED_OTHER) };
+        pthread_attr_setinheritsched(&native_attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&native_attr, SCHED_OTHER);
+        pthread_attr_setschedparam(&native_attr, &param);
+    }
+
+    start_info *info = ga_new(start_info);
+    info->func = func;
+    info->data = data;
+    info->prefault = (attr->prefault_stack && stack_size > PREFAULT_MARGIN) ? stack_size - PREFAULT_MARGIN : 0;
+    info->name = attr->name ? strdup(attr->name) : NULL;
+
+    // Like on Linux, fall back to the default policy if the requested one is refused
+    int result = pthread_create(&thread->native, &native_attr, trampoline, info);
+    if ((result == EPERM || result == EINVAL) && (realtime || idle)) {
+        ga_log_warning("%s not %s for thread '%s', using default policy",
+               realtime ? "Realtime priority" : "Idle policy", result == EPERM ? "permitted" : "valid",
+               attr->name ? attr->name : "<unnamed>");
+        pthread_attr_setinheritsched(&native_attr, PTHREAD_INHERIT_SCHED);
+        realtime = idle = false;
+        result = pthread_create(&thread->native, &native_attr, trampoline, info);
+    }
+    pthread_attr_destroy(&native_attr);
 
     if (result != 0) {
         fatal_error("Couldn't spawn thread! %d", result);
     }
 
-    if (name) {
-        printf("New thread %p '%s'\n", &thread->native, name);
+    // With PTHREAD_EXPLICIT_SCHED, pthread_create fails unless the policy could be applied
+    thread->policy = (realtime || idle) ? attr->policy : GA_THREAD_POLICY_DEFAULT;
+    thread->priority = realtime ? attr->priority : 0;
+
+    if (attr->name) {
+        ga_log_debug("New thread %p '%s'", &thread->native, attr->name);
     }
 
     return thread;
 }
 
+ga_thread_policy ga_thread_get_policy(ga_thread *thread)
+{
+    return thread->policy;
+}
+
+int ga_thread_get_priority(ga_thread *thread)
+{
+    return thread->priority;
+}
+
 void ga_thread_sleep(unsigned int ms)
 {
     usleep(ms * 1000);
@@ -81,7 +199,7 @@ void* ga_thread_join(ga_thread *thread)
         fatal_error("pthread_join: %d for thread %s", result, thread->name ? thread->name : "<unnamed>");
     }
     if (thread->name) {
-        printf("Joined thread %p '%s', return value: %p\n", thread->native, thread->name, return_value);
+        ga_log_debug("Joined thread %p '%s', return value: %p", thread->native, thread->name, return_value);
         free(thread->name);
     }
     ga_free(thread);
@@ -96,7 +214,7 @@ void ga_thread_detach(ga_thread *thread)
         fatal_error("pthread_detach: %d for thread %s", result, thread->name ? thread->name : "<unnamed>");
     }
     if (thread->name) {
-        printf("Detached thread %p '%s'\n", thread->native, thread->name);
+        ga_log_debug("Detached thread %p '%s'", thread->native, thread->name);
         free(thread->name);
     }
 
@@ -114,71 +232,4 @@ bool ga_thread_is_current(ga_thread *thread)
     return thread->native == pthread_self();
 }
 
-
-// --------------------------------------------------------------------------------
-
-// ga_mutex_t ga_thread_create_mutex()
-// {
-//     ga_mutex_t mutex = ga_new(ga_mutex_t);
-
-//     int result = pthread_mutex_init(&mutex->native, NULL);
-
-//     if (result != 0) {
-//         fatal_error("create_mutex %d", result);
-//     }
-
-//     return mutex;
-// }
-
-// void ga_thread_destroy_mutex(ga_thread_mutex_t mutex)
-// {
-//     int result = pthread_mutex_destroy(&mutex->native);
-//     ga_delete(mutex);
-
-//     if (result != 0) {
-//         ga_thread_fatal("destroy_mutex", result);
-//     }
-// }
-
-// bool ga_thread_lock(ga_thread_mutex_t mutex)
-// {
-//     int result = pthread_mutex_lock(&mutex->native);
-
-//     if (result == 0) {
-//         return true;
-//     } else {
-//         ga_thread_fatal("unlock", result);
-//         assert(false && "Not reached");
-//     }
-// }
-
-// bool ga_thread_try_lock(ga_thread_mutex_t mutex)
-// {
-//     int result = pthread_mutex_trylock(&mutex->native);
-
-//     switch (result) {
-//     case 0:
-//         return true;
-
-//     case EBUSY:
-//         return false;
-
-//     default:
-//         ga_thread_fatal("try_lock", result);
-//         assert(false && "Not reached");
-//     }
-// }
-
-// bool ga_thread_unlock(ga_thread_mutex_t mutex)
-// {
-//     int result = pthread_mutex_unlock(&mutex->native);
-
-//     if (result == 0) {
-//         return true;
-//     } else {
-//         ga_thread_fatal("unlock", result);
-//         assert(false && "Not reached");
-//     }
-// }
-
 #endif
@@ -22,6 +22,7 @@ struct ga_mpmcq {
   cacheline_pad           pad0;
   cell_t*                 buffer;
   size_t                  buffer_mask;
+  ga_queue_counters*      stats;
   cacheline_pad           pad1;
   atomic_size_t           write_pos;
   cacheline_pad           pad2;
@@ -30,11 +31,20 @@ struct ga_mpmcq {
 };
 
 ga_mpmcq* ga_mpmcq_create(size_t capacity)
+{
+    return ga_mpmcq_create_with_flags(capacity, GA_MEM_DEFAULT);
+}
+
+ga_mpmcq* ga_mpmcq_create_with_flags(size_t capacity, ga_mem_flags flags)
 {
     assert((capacity >= 2) && ((capacity & (capacity - 1)) == 0));
-    ga_mpmcq *queue = ga_newc(ga_mpmcq);
+    ga_mpmcq *queue = ga_newc_aligned(ga_mpmcq);
     queue->buffer_mask = capacity - 1;
-    queue->buffer = ga_calloc(capacity, sizeof(cell_t));
+    if (flags) {
+        queue->buffer = ga_calloc_realtime(capacity, sizeof(cell_t), flags, GA_ALLOC_TAG_QUEUE);
+    } else {
+        queue->buffer = ga_calloc_aligned_tagged(CACHELINE_SIZE, capacity, sizeof(cell_t), GA_ALLOC_TAG_QUEUE);
+    }
     for (size_t i = 0; i < capacity; i++) {
         atomic_store_explicit(&queue->buffer[i].sequence, i, memory_order_relaxed);
     }
@@ -45,10 +55,46 @@ ga_mpmcq* ga_mpmcq_create(size_t capacity)
 
 void ga_mpmcq_destroy(ga_mpmcq *queue)
 {
+    if (queue->stats) ga_queue_unregister(queue->stats);
     ga_free(queue->buffer);
     ga_free(queue);
 }
 
+static void read_stats(void *data, ga_queue_stats *stats)
+{
+    ga_mpmcq *queue = data;
+    if (queue->stats) ga_queue_read_counters(queue->stats, stats);
+    // Pops first, so that depth can't go negative
+    size_t pops = atomic_load_explicit(&queue->read_pos, memory_order_relaxed);
+    size_t pushes = atomic_load_explicit(&queue->write_pos, memory_order_relaxed);
+    stats->kind = "mpmcq";
+    stats->capacity = queue->buffer_mask + 1;
+    stats->pushes = pushes;
+    stats->pops = pops;
+    stats->depth = pushes - pops;
+}
+
+void ga_mpmcq_enable_stats(ga_mpmcq *queue, const char *name)
+{
+    assert(!queue->stats && "Stats already enabled");
+    queue->stats = ga_queue_register(name, "mpmcq", queue, read_stats);
+}
+
+void ga_mpmcq_get_stats(ga_mpmcq *queue, ga_queue_stats *stats)
+{
+    memset(stats, 0, sizeof(ga_queue_stats));
+    read_stats(queue, stats);
+}
+
+// Several producers, so the high water mark needs a compare and swap
+static inline void count_depth(ga_mpmcq *queue, size_t write_pos)
+{
+    size_t depth = write_pos - atomic_load_explicit(&queue->read_pos, memory_order_relaxed);
+    size_t high = atomic_load_explicit(&queue->stats->high_water, memory_order_relaxed);
+    while (depth > high && depth <= queue->buffer_mask + 1
+           && !atomic_compare_exchange_weak_explicit(&queue->stats->high_water, &high, depth, memory_order_relaxed, memory_order_relaxed));
+}
+
 bool ga_mpmcq_push(ga_mpmcq *queue, void *value)
 {
     cell_t* cell;
@@ -64,12 +110,16 @@ bool ga_mpmcq_push(ga_mpmcq *queue, void *value)
           break;
       }
       else if (dif < 0)
+      {
+        if (queue->stats) atomic_fetch_add_explicit(&queue->stats->overflows, 1, memory_order_relaxed);
         return false;
+      }
       else
         pos = atomic_load_explicit(&queue->write_pos, memory_order_relaxed);
     }
     cell->data = value;
     atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    if (queue->stats) count_depth(queue, pos + 1);
     return true;
 }
 
@@ -88,7 +138,10 @@ void* ga_mpmcq_pop(ga_mpmcq *queue)
           break;
       }
       else if (dif < 0)
+      {
+        if (queue->stats) atomic_fetch_add_explicit(&queue->stats->underflows, 1, memory_order_relaxed);
         return NULL;
+      }
       else
         pos = atomic_load_explicit(&queue->read_pos, memory_order_relaxed);
     }
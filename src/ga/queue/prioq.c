@@ -29,7 +29,7 @@ inline static qnode* new_node(ga_prioq *queue, void *value, qnode *left, qnode *
         node = queue->free_nodes;
         queue->free_nodes = node->left;
     } else {
-        node = ga_new(qnode);
+        node = ga_malloc_tagged(sizeof(qnode), GA_ALLOC_TAG_QUEUE);
     }
     node->value = value;
     node->left  = left;
@@ -73,7 +73,7 @@ void ga_prioq_destroy(ga_prioq *queue)
 void ga_prioq_preallocate(ga_prioq *queue, unsigned int count)
 {
     for (unsigned int i = 0; i < count; i++) {
-        qnode *node = ga_newc(qnode);
+        qnode *node = ga_calloc_tagged(1, sizeof(qnode), GA_ALLOC_TAG_QUEUE);
         node->left = queue->free_nodes;
         queue->free_nodes = node;
     }
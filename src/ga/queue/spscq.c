@@ -5,10 +5,12 @@
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "ga/util.h"
 #include "ga/alloc.h"
 #include "ga/thread.h"
+#include "ga/util/time.h"
 
 typedef ga_spscq_overflow_strategy overflow_strategy;
 
@@ -18,24 +20,36 @@ struct ga_spscq {
     atomic_size_t       count;                  //  Number of items in the queue (always <= size)
     void                **data;                 //  The actual data buffer
     overflow_strategy   on_overflow;            //  What to do if buffer overflows
-    size_t              overflows;              //  Number of overflows
+    atomic_ullong       overflows;              //  Number of overflows, written by the producer
     ga_spscq_callback   error_callback;         //
     void                *error_callback_data;
+    ga_histogram        *block_histogram;       //  Time spent blocked in push
+    ga_queue_counters   *stats;                 //  Optional telemetry
 };
 
 
 ga_spscq* ga_spscq_create(size_t capacity, ga_spscq_overflow_strategy on_overflow)
+{
+    return ga_spscq_create_with_flags(capacity, on_overflow, GA_MEM_DEFAULT);
+}
+
+ga_spscq* ga_spscq_create_with_flags(size_t capacity, ga_spscq_overflow_strategy on_overflow, ga_mem_flags flags)
 {
     assert(on_overflow != SPSCQ_OVERFLOW_GROW); // Not implemented
     ga_spscq *queue = ga_newc(ga_spscq);
     queue->size = capacity;
     queue->on_overflow = on_overflow;
-    queue->data = ga_calloc(capacity, sizeof(void*));
+    if (flags) {
+        queue->data = ga_calloc_realtime(capacity, sizeof(void*), flags, GA_ALLOC_TAG_QUEUE);
+    } else {
+        queue->data = ga_calloc_aligned_tagged(CACHELINE_SIZE, capacity, sizeof(void*), GA_ALLOC_TAG_QUEUE);
+    }
     return queue;
 }
 
 void ga_spscq_destroy(ga_spscq *queue)
 {
+    if (queue->stats) ga_queue_unregister(queue->stats);
     ga_free(queue->data);
     ga_free(queue);
 }
@@ -46,6 +60,33 @@ void ga_spscq_set_error_callback(ga_spscq *queue, ga_spscq_callback callback, vo
     queue->error_callback_data = data;
 }
 
+void ga_spscq_set_histogram(ga_spscq *queue, ga_histogram *histogram)
+{
+    queue->block_histogram = histogram;
+}
+
+static void read_stats(void *data, ga_queue_stats *stats)
+{
+    ga_spscq *queue = data;
+    if (queue->stats) ga_queue_read_counters(queue->stats, stats);
+    stats->kind = "spscq";
+    stats->capacity = queue->size;
+    stats->depth = ga_spscq_can_pop(queue);
+    stats->overflows = atomic_load_explicit(&queue->overflows, memory_order_relaxed);
+}
+
+void ga_spscq_enable_stats(ga_spscq *queue, const char *name)
+{
+    assert(!queue->stats && "Stats already enabled");
+    queue->stats = ga_queue_register(name, "spscq", queue, read_stats);
+}
+
+void ga_spscq_get_stats(ga_spscq *queue, ga_queue_stats *stats)
+{
+    memset(stats, 0, sizeof(ga_queue_stats));
+    read_stats(queue, stats);
+}
+
 size_t ga_spscq_can_push(ga_spscq *queue)
 {
     return queue->size - atomic_load_explicit(&queue->count, memory_order_acquire);
@@ -59,15 +100,19 @@ size_t ga_spscq_can_pop(ga_spscq *queue)
 bool ga_spscq_push(ga_spscq *queue, void *value)
 {
     if (!ga_spscq_can_push(queue)) {
-        queue->overflows++;
+        ga_queue_count(&queue->overflows);
         switch(queue->on_overflow) {
         case SPSCQ_OVERFLOW_DISCARD:
             return false;
-        case SPSCQ_OVERFLOW_BLOCK:
+        case SPSCQ_OVERFLOW_BLOCK: {
+            if (queue->stats) ga_queue_count(&queue->stats->full_stalls);
+            uint64_t start = queue->block_histogram ? ga_now_ns() : 0;
             while(!ga_spscq_can_push(queue)) {
                 ga_thread_sleep(1);
             }
+            if (queue->block_histogram) ga_histogram_record(queue->block_histogram, ga_now_ns() - start);
             break;
+        }
         case SPSCQ_OVERFLOW_GROW:
             assert(false && "Not implemented");
             break;
@@ -85,16 +130,24 @@ bool ga_spscq_push(ga_spscq *queue, void *value)
     }
     queue->data[queue->write_pos] = value;
     queue->write_pos = (queue->write_pos + 1) % queue->size;
-    atomic_fetch_add_explicit(&queue->count, 1, memory_order_release);
+    size_t depth = atomic_fetch_add_explicit(&queue->count, 1, memory_order_release) + 1;
+    if (queue->stats) {
+        ga_queue_count(&queue->stats->pushes);
+        ga_queue_count_depth(queue->stats, depth);
+    }
     return true;
 }
 
 void* ga_spscq_pop(ga_spscq *queue)
 {
-    if (!ga_spscq_can_pop(queue)) return NULL;
+    if (!ga_spscq_can_pop(queue)) {
+        if (queue->stats) ga_queue_count_pop(queue->stats, false);
+        return NULL;
+    }
     void *value = queue->data[queue->read_pos];
     queue->read_pos = (queue->read_pos + 1) % queue->size;
     atomic_fetch_sub_explicit(&queue->count, 1, memory_order_release);
+    if (queue->stats) ga_queue_count_pop(queue->stats, true);
     return value;
 }
 
@@ -0,0 +1,103 @@
+#include "ga/queue/stats.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+
+typedef struct entry entry;
+struct entry {
+    ga_queue_counters   *counters;
+    const char          *kind;
+    void                *queue;
+    ga_queue_stats_func func;
+    entry               *next;
+};
+
+// Registering and snapshotting are not realtime operations, so a plain mutex will do
+static pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+static entry *gEntries = NULL;
+static size_t gCount = 0;
+
+// -----------------------------------------------------------------------------
+
+ga_queue_counters* ga_queue_register(const char *name, const char *kind, void *queue, ga_queue_stats_func func)
+{
+    ga_queue_counters *counters = ga_newc_aligned(ga_queue_counters);
+    counters->name = strdup(name ? name : "");
+
+    entry *e = ga_new(entry);
+    e->counters = counters;
+    e->kind = kind;
+    e->queue = queue;
+    e->func = func;
+
+    pthread_mutex_lock(&gLock);
+    e->next = gEntries;
+    gEntries = e;
+    gCount++;
+    pthread_mutex_unlock(&gLock);
+    return counters;
+}
+
+void ga_queue_unregister(ga_queue_counters *counters)
+{
+    pthread_mutex_lock(&gLock);
+    for (entry **e = &gEntries; *e; e = &(*e)->next) {
+        if ((*e)->counters == counters) {
+            entry *found = *e;
+            *e = found->next;
+            gCount--;
+            ga_free(found);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&gLock);
+    free(counters->name);
+    ga_free(counters);
+}
+
+size_t ga_queue_registry_count()
+{
+    pthread_mutex_lock(&gLock);
+    size_t count = gCount;
+    pthread_mutex_unlock(&gLock);
+    return count;
+}
+
+// Fills in the stats of up to max registered queues, returns how many
+size_t ga_queue_registry_snapshot(ga_queue_stats *stats, size_t max)
+{
+    size_t count = 0;
+    pthread_mutex_lock(&gLock);
+    for (entry *e = gEntries; e && count < max; e = e->next) {
+        memset(&stats[count], 0, sizeof(ga_queue_stats));
+        e->func(e->queue, &stats[count]);
+        count++;
+    }
+    pthread_mutex_unlock(&gLock);
+    return count;
+}
+
+void ga_queue_registry_print(FILE *file)
+{
+    size_t max = ga_queue_registry_count();
+    ga_queue_stats *stats = ga_malloc((max ? max : 1) * sizeof(ga_queue_stats));
+    size_t count = ga_queue_registry_snapshot(stats, max);
+
+    fprintf(file, "%-20s %-12s %10s %10s %10s %12s %12s %10s %10s %8s %8s\n",
+            "queue", "kind", "capacity", "depth", "high", "pushes", "pops",
+            "overflows", "underflows", "full", "empty");
+    for (size_t i = 0; i < count; i++) {
+        ga_queue_stats *s = &stats[i];
+        fprintf(file, "%-20s %-12s %10zu %10zu %10zu %12llu %12llu %10llu %10llu %8llu %8llu\n",
+                s->name, s->kind, s->capacity, s->depth, s->high_water,
+                (unsigned long long)s->pushes, (unsigned long long)s->pops,
+                (unsigned long long)s->overflows, (unsigned long long)s->underflows,
+                (unsigned long long)s->full_stalls, (unsigned long long)s->empty_stalls);
+    }
+    ga_free(stats);
+}
@@ -0,0 +1,38 @@
+#include "ga/realtime.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "ga/log.h"
+
+_Thread_local unsigned int ga_realtime_depth = 0;
+
+static _Atomic(ga_realtime_action) gAction = GA_REALTIME_COUNT;
+static atomic_size_t gViolations = 0;
+
+void ga_realtime_set_action(ga_realtime_action action)
+{
+    atomic_store(&gAction, action);
+}
+
+size_t ga_realtime_violations()
+{
+    return atomic_load_explicit(&gViolations, memory_order_relaxed);
+}
+
+void ga_realtime_violation(const char *func, void *call_site)
+{
+    atomic_fetch_add_explicit(&gViolations, 1, memory_order_relaxed);
+    switch (atomic_load_explicit(&gAction, memory_order_relaxed)) {
+    case GA_REALTIME_COUNT:
+        break;
+    case GA_REALTIME_LOG:
+        ga_log_warning("Realtime violation: %s called from %p", func, call_site);
+        break;
+    case GA_REALTIME_ABORT:
+        // Not using fatal_error, since it may allocate
+        printf("FATAL ERROR: Realtime violation: %s called from %p\n", func, call_site);
+        abort();
+    }
+}
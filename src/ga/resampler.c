@@ -0,0 +1,260 @@
+#include "ga/resampler.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/dsp.h"
+
+#define PI          3.14159265358979323846
+#define CHUNK       256         //  Frames read from the source at a time
+#define MAX_TAPS    1024
+#define MIN_SCALE   0.98        //  Above this, the presets' rolloff is margin enough for the aliasing
+
+typedef struct preset {
+    unsigned int taps;
+    unsigned int phases;
+    double beta;                //  Kaiser window shape
+    double rolloff;             //  Cutoff, relative to the lower Nyquist frequency
+} preset;
+
+static const preset gPresets[] = {
+    { 16,  64,  6.0, 0.85 },    //  GA_RESAMPLER_FAST
+    { 32,  128, 8.0, 0.90 },    //  GA_RESAMPLER_MEDIUM
+    { 64,  256, 10.0, 0.94 }    //  GA_RESAMPLER_BEST
+};
+
+struct ga_resampler {
+    unsigned int    channels;
+    unsigned int    taps;
+    unsigned int    phases;
+    float           *filter;            //  (phases + 1) rows of taps, for fractions 0 to 1
+    double          min_ratio, max_ratio;
+    double          ratio;
+    double          step;               //  Input frames per output frame
+    float           **history;          //  Input per channel, planar
+    size_t          capacity;           //  Frames per history
+    size_t          available;          //  Frames in history
+    double          position;           //  Of the next output frame in history (first tap)
+    float           *scratch;           //  Interleaved frames read from the source
+    atomic_ullong   underruns;
+    ga_ring_buffer  *source;            //  For ga_resampler_process_node
+    float           *output;
+};
+
+// -----------------------------------------------------------------------------
+
+// Filters are padded to whole vectors of the selected kernels (at least 4, so taps stay even)
+static unsigned int tap_align()
+{
+    switch (ga_dsp_get_isa()) {
+    case GA_DSP_AVX512: return 16;
+    case GA_DSP_AVX2:   return 8;
+    default:            return 4;
+    }
+}
+
+// Modified Bessel function of the first kind, order 0
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+// Row p holds the taps for a position p / phases of the way to the next input frame
+static void design_filter(ga_resampler *resampler, double cutoff, double beta)
+{
+    unsigned int taps = resampler->taps;
+    double half = taps / 2.0;
+    for (unsigned int p = 0; p <= resampler->phases; p++) {
+        float *row = resampler->filter + p * taps;
+        double fraction = (double)p / resampler->phases, sum = 0.0;
+        for (unsigned int k = 0; k < taps; k++) {
+            double t = k - (half - 1.0) - fraction;
+            double x = t / half;
+            double window = fabs(x) < 1.0 ? bessel_i0(beta * sqrt(1.0 - x * x)) / bessel_i0(beta) : 0.0;
+            double sinc = t == 0.0 ? 1.0 : sin(PI * cutoff * t) / (PI * cutoff * t);
+            row[k] = cutoff * sinc * window;
+            sum += row[k];
+        }
+        // Unity gain at DC for every phase
+        for (unsigned int k = 0; k < taps; k++) row[k] /= sum;
+    }
+}
+
+ga_resampler* ga_resampler_create(unsigned int channels, ga_resampler_quality quality, double min_ratio, double max_ratio)
+{
+    assert(channels > 0);
+    assert(quality <= GA_RESAMPLER_BEST);
+    assert(min_ratio > 0.0 && min_ratio <= max_ratio);
+
+    const preset *preset = &gPresets[quality];
+    double scale = min_ratio < 1.0 ? min_ratio : 1.0;
+    unsigned int taps = scale < MIN_SCALE ? ceil(preset->taps / scale) : preset->taps;
+    taps = (taps + tap_align() - 1) / tap_align() * tap_align();
+    if (taps > MAX_TAPS) fatal_error("Resampler ratio range too wide");
+
+    ga_resampler *resampler = ga_newc(ga_resampler);
+    resampler->channels = channels;
+    resampler->taps = taps;
+    resampler->phases = preset->phases;
+    resampler->min_ratio = min_ratio;
+    resampler->max_ratio = max_ratio;
+    resampler->filter = ga_calloc_realtime((preset->phases + 1) * taps, sizeof(float), GA_MEM_REALTIME, GA_ALLOC_TAG_DEFAULT);
+    design_filter(resampler, preset->rolloff * scale, preset->beta);
+
+    resampler->capacity = taps + CHUNK;
+    resampler->history = ga_malloc(channels * sizeof(float*));
+    for (unsigned int c = 0; c < channels; c++) {
+        resampler->history[c] = ga_calloc_realtime(resampler->capacity, sizeof(float), GA_MEM_REALTIME, GA_ALLOC_TAG_DEFAULT);
+    }
+    resampler->scratch = ga_calloc_realtime(CHUNK * channels, sizeof(float), GA_MEM_REALTIME, GA_ALLOC_TAG_DEFAULT);
+
+    ga_resampler_set_ratio(resampler, 1.0);
+    ga_resampler_reset(resampler);
+    return resampler;
+}
+
+void ga_resampler_destroy(ga_resampler *resampler)
+{
+    for (unsigned int c = 0; c < resampler->channels; c++) {
+        ga_free(resampler->history[c]);
+    }
+    ga_free(resampler->history);
+    ga_free(resampler->scratch);
+    ga_free(resampler->filter);
+    ga_free(resampler);
+}
+
+void ga_resampler_reset(ga_resampler *resampler)
+{
+    // Silence before the first frame, so that it lines up with the filter centre
+    resampler->available = resampler->taps / 2 - 1;
+    for (unsigned int c = 0; c < resampler->channels; c++) {
+        memset(resampler->history[c], 0, resampler->available * sizeof(float));
+    }
+    resampler->position = 0.0;
+}
+
+// Clamps the ratio to the range given at creation, returning false if it had to
+bool ga_resampler_set_ratio(ga_resampler *resampler, double ratio)
+{
+    bool in_range = ratio >= resampler->min_ratio && ratio <= resampler->max_ratio;
+    if (ratio < resampler->min_ratio) ratio = resampler->min_ratio;
+    if (ratio > resampler->max_ratio) ratio = resampler->max_ratio;
+    resampler->ratio = ratio;
+    resampler->step = 1.0 / ratio;
+    return in_range;
+}
+
+double ga_resampler_get_ratio(ga_resampler *resampler)
+{
+    return resampler->ratio;
+}
+
+unsigned int ga_resampler_latency(ga_resampler *resampler)
+{
+    return resampler->taps / 2;
+}
+
+// Input frames read from the source but not yet consumed
+double ga_resampler_buffered(ga_resampler *resampler)
+{
+    double buffered = resampler->available - resampler->position - (resampler->taps / 2 - 1);
+    return buffered > 0.0 ? buffered : 0.0;
+}
+
+uint64_t ga_resampler_underruns(ga_resampler *resampler)
+{
+    return atomic_load_explicit(&resampler->underruns, memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------
+
+// Drops consumed input and reads more from the source, returns false if there was none
+static bool refill(ga_resampler *resampler, ga_ring_buffer *source)
+{
+    unsigned int channels = resampler->channels;
+    size_t consumed = (size_t)resampler->position;
+    if (consumed) {
+        for (unsigned int c = 0; c < channels; c++) {
+            memmove(resampler->history[c], resampler->history[c] + consumed, (resampler->available - consumed) * sizeof(float));
+        }
+        resampler->available -= consumed;
+        resampler->position -= consumed;
+    }
+
+    size_t frame_size = channels * sizeof(float);
+    size_t frames = ga_ring_buffer_can_read(source) / frame_size;
+    size_t space = resampler->capacity - resampler->available;
+    if (frames > space) frames = space;
+    if (frames > CHUNK) frames = CHUNK;
+    if (!frames) return false;
+
+    ga_ring_buffer_read(source, frames * frame_size, resampler->scratch);
+    for (unsigned int c = 0; c < channels; c++) {
+        float *history = resampler->history[c] + resampler->available;
+        for (size_t i = 0; i < frames; i++) {
+            history[i] = resampler->scratch[i * channels + c];
+        }
+    }
+    resampler->available += frames;
+    return true;
+}
+
+size_t ga_resampler_process(ga_resampler *resampler, ga_ring_buffer *source, float *output, size_t frames)
+{
+    unsigned int channels = resampler->channels, taps = resampler->taps;
+    size_t produced = 0;
+
+    while (produced < frames) {
+        size_t index = (size_t)resampler->position;
+        if (index + taps > resampler->available) {
+            if (!refill(resampler, source)) break;
+            continue;
+        }
+
+        // Interpolate between the outputs of the two nearest phases
+        double phase = (resampler->position - index) * resampler->phases;
+        unsigned int p = (unsigned int)phase;
+        float fraction = phase - p;
+        const float *row0 = resampler->filter + p * taps, *row1 = row0 + taps;
+        float *frame = output + produced * channels;
+        for (unsigned int c = 0; c < channels; c++) {
+            const float *input = resampler->history[c] + index;
+            float a = ga_dsp_dot(input, row0, taps);
+            float b = ga_dsp_dot(input, row1, taps);
+            frame[c] = a + fraction * (b - a);
+        }
+
+        resampler->position += resampler->step;
+        produced++;
+    }
+
+    if (produced < frames) {
+        memset(output + produced * channels, 0, (frames - produced) * channels * sizeof(float));
+        atomic_store_explicit(&resampler->underruns, atomic_load_explicit(&resampler->underruns, memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+    return produced;
+}
+
+void ga_resampler_set_io(ga_resampler *resampler, ga_ring_buffer *source, float *output)
+{
+    resampler->source = source;
+    resampler->output = output;
+}
+
+void ga_resampler_process_node(void *data, unsigned int frames)
+{
+    ga_resampler *resampler = data;
+    ga_resampler_process(resampler, resampler->source, resampler->output, frames);
+}
@@ -16,19 +16,30 @@ struct ga_ring_buffer {
     void                     *data;                 //  The actual data
     ga_ring_buffer_callback  error_callback;        //
     void                     *error_callback_data;
+    ga_queue_counters        *stats;                //  Optional telemetry
 };
 
 
 ga_ring_buffer* ga_ring_buffer_create(size_t size)
+{
+    return ga_ring_buffer_create_with_flags(size, GA_MEM_DEFAULT);
+}
+
+ga_ring_buffer* ga_ring_buffer_create_with_flags(size_t size, ga_mem_flags flags)
 {
     ga_ring_buffer *ring_buffer = ga_newc(ga_ring_buffer);
     ring_buffer->size = size;
-    ring_buffer->data = ga_malloc(size);
+    if (flags) {
+        ring_buffer->data = ga_malloc_realtime(size, flags, GA_ALLOC_TAG_RING_BUFFER);
+    } else {
+        ring_buffer->data = ga_malloc_aligned_tagged(CACHELINE_SIZE, size, GA_ALLOC_TAG_RING_BUFFER);
+    }
     return ring_buffer;
 }
 
 void ga_ring_buffer_destroy(ga_ring_buffer *ring_buffer)
 {
+    if (ring_buffer->stats) ga_queue_unregister(ring_buffer->stats);
     ga_free(ring_buffer->data);
     ga_free(ring_buffer);
 }
@@ -39,6 +50,28 @@ void ga_ring_buffer_set_error_callback(ga_ring_buffer *ring_buffer, ga_ring_buff
     ring_buffer->error_callback_data = data;
 }
 
+static void read_stats(void *data, ga_queue_stats *stats)
+{
+    ga_ring_buffer *ring_buffer = data;
+    if (ring_buffer->stats) ga_queue_read_counters(ring_buffer->stats, stats);
+    stats->kind = "ring_buffer";
+    stats->capacity = ring_buffer->size;
+    stats->depth = ga_ring_buffer_can_read(ring_buffer);
+}
+
+// Writes and reads count as pushes and pops, sizes are in bytes
+void ga_ring_buffer_enable_stats(ga_ring_buffer *ring_buffer, const char *name)
+{
+    assert(!ring_buffer->stats && "Stats already enabled");
+    ring_buffer->stats = ga_queue_register(name, "ring_buffer", ring_buffer, read_stats);
+}
+
+void ga_ring_buffer_get_stats(ga_ring_buffer *ring_buffer, ga_queue_stats *stats)
+{
+    memset(stats, 0, sizeof(ga_queue_stats));
+    read_stats(ring_buffer, stats);
+}
+
 size_t ga_ring_buffer_can_read(ga_ring_buffer *ring_buffer)
 {
     return atomic_load_explicit(&ring_buffer->count, memory_order_acquire);
@@ -65,7 +98,11 @@ static inline void internal_write(ga_ring_buffer *ring_buffer, size_t bytes, voi
         memcpy(ring_buffer->data, data + to_end, bytes_left);
         ring_buffer->last = bytes_left;
     }
-    atomic_fetch_add_explicit(&ring_buffer->count, bytes, memory_order_release);
+    size_t depth = atomic_fetch_add_explicit(&ring_buffer->count, bytes, memory_order_release) + bytes;
+    if (ring_buffer->stats) {
+        ga_queue_count(&ring_buffer->stats->pushes);
+        ga_queue_count_depth(ring_buffer->stats, depth);
+    }
 }
 
 static inline void internal_read(ga_ring_buffer *ring_buffer, size_t bytes, void *data)
@@ -79,10 +116,11 @@ static inline void internal_read(ga_ring_buffer *ring_buffer, size_t bytes, void
         size_t to_end = ring_buffer->size - ring_buffer->first;
         memcpy(data, ring_buffer->data + ring_buffer->first, to_end);
         size_t bytes_left = bytes - to_end;
-        memcpy(ring_buffer->data, data + to_end, bytes_left);
+        memcpy(data + to_end, ring_buffer->data, bytes_left);
         ring_buffer->first = bytes_left;
     }
     atomic_fetch_sub_explicit(&ring_buffer->count, bytes, memory_order_release);
+    if (ring_buffer->stats) ga_queue_count_pop(ring_buffer->stats, true);
 }
 
 size_t ga_ring_buffer_write(ga_ring_buffer *ring_buffer, size_t bytes, void *data)
@@ -92,6 +130,7 @@ size_t ga_ring_buffer_write(ga_ring_buffer *ring_buffer, size_t bytes, void *dat
     size_t can_write = ga_ring_buffer_can_write(ring_buffer);
     if (can_write < bytes) {
         bytes = can_write;
+        if (ring_buffer->stats) ga_queue_count(&ring_buffer->stats->overflows);
         if (ring_buffer->error_callback) {
             ring_buffer->error_callback(ring_buffer, GA_ERROR_OVERFLOW, ring_buffer->error_callback_data);
         }
@@ -106,6 +145,7 @@ size_t ga_ring_buffer_write_atomic(ga_ring_buffer *ring_buffer, size_t bytes, vo
     assert(bytes <= ring_buffer->size);
     if (!bytes) return 0;
     if (bytes > ga_ring_buffer_can_write(ring_buffer)) {
+        if (ring_buffer->stats) ga_queue_count(&ring_buffer->stats->overflows);
         if (ring_buffer->error_callback) {
             ring_buffer->error_callback(ring_buffer, GA_ERROR_OVERFLOW, ring_buffer->error_callback_data);
         }
@@ -122,6 +162,7 @@ size_t ga_ring_buffer_read(ga_ring_buffer *ring_buffer, size_t bytes, void *data
     size_t can_read = ga_ring_buffer_can_read(ring_buffer);
     if (can_read < bytes) {
         bytes = can_read;
+        if (ring_buffer->stats) ga_queue_count_pop(ring_buffer->stats, false);
         if (ring_buffer->error_callback) {
             ring_buffer->error_callback(ring_buffer, GA_ERROR_UNDERFLOW, ring_buffer->error_callback_data);
         }
@@ -136,6 +177,7 @@ size_t ga_ring_buffer_read_atomic(ga_ring_buffer *ring_buffer, size_t bytes, voi
     assert(bytes <= ring_buffer->size);
     if (!bytes) return 0;
     if (bytes > ga_ring_buffer_can_read(ring_buffer)) {
+        if (ring_buffer->stats) ga_queue_count_pop(ring_buffer->stats, false);
         if (ring_buffer->error_callback) {
             ring_buffer->error_callback(ring_buffer, GA_ERROR_UNDERFLOW, ring_buffer->error_callback_data);
         }
@@ -145,6 +187,17 @@ size_t ga_ring_buffer_read_atomic(ga_ring_buffer *ring_buffer, size_t bytes, voi
     return bytes;
 }
 
+size_t ga_ring_buffer_skip(ga_ring_buffer *ring_buffer, size_t bytes)
+{
+    size_t can_read = ga_ring_buffer_can_read(ring_buffer);
+    if (bytes > can_read) bytes = can_read;
+    if (!bytes) return 0;
+    ring_buffer->first = (ring_buffer->first + bytes) % ring_buffer->size;
+    atomic_fetch_sub_explicit(&ring_buffer->count, bytes, memory_order_release);
+    if (ring_buffer->stats) ga_queue_count_pop(ring_buffer->stats, true);
+    return bytes;
+}
+
 
 static char* char_repeat(int n, char c) {
     char *dest = malloc(n+1);
@@ -1,27 +1,133 @@
 #include "ga/semaphore.h"
 
-#define MAX_SEMAPHORES 32
+#include <stdint.h>
+#include <assert.h>
+#include <time.h>
+#include <limits.h>
 
-ga_semaphore ga_semaphores[MAX_SEMAPHORES] = {};
+#include "ga/alloc.h"
+#include "ga/futex.h"
+#include "ga/util/time.h"
+
+// Number of try_wait attempts before going to sleep
+#define SPIN_COUNT 100
+
+ga_semaphore *_Atomic ga_semaphore_blocks[GA_SEMAPHORE_MAX_BLOCKS] = {};
+
+static _Atomic(uint64_t) gUsed[GA_SEMAPHORE_MAX_BLOCKS] = {};      // One bit per semaphore
+static atomic_uint gBlockCount = 0;                                 // Number of allocated blocks
+static atomic_uint gMaxBlocks = GA_SEMAPHORE_DEFAULT_CAPACITY / GA_SEMAPHORE_BLOCK_SIZE;
+static atomic_uint gHint = 0;                                       // Block likely to have a free slot
+
+// Make sure there are at least count blocks, returns false if over capacity
+static bool grow(unsigned int count)
+{
+    if (count > atomic_load(&gMaxBlocks)) return false;
+    for (unsigned int i = atomic_load(&gBlockCount); i < count; i++) {
+        if (atomic_load(&ga_semaphore_blocks[i])) continue;
+        ga_semaphore *block = ga_calloc_aligned(CACHELINE_SIZE, GA_SEMAPHORE_BLOCK_SIZE, sizeof(ga_semaphore));
+        ga_semaphore *expected = NULL;
+        if (!atomic_compare_exchange_strong(&ga_semaphore_blocks[i], &expected, block)) {
+            ga_free(block); // Someone else got there first
+        }
+    }
+    unsigned int old = atomic_load(&gBlockCount);
+    while (old < count && !atomic_compare_exchange_weak(&gBlockCount, &old, count));
+    return true;
+}
+
+// Claim a free slot in the given block, or return -1
+static inline int claim(unsigned int block)
+{
+    uint64_t used = atomic_load_explicit(&gUsed[block], memory_order_relaxed);
+    while (~used) {
+        int bit = __builtin_ctzll(~used);
+        if (atomic_compare_exchange_weak_explicit(&gUsed[block], &used, used | (1ull << bit),
+                                                  memory_order_acquire, memory_order_relaxed)) {
+            return block * GA_SEMAPHORE_BLOCK_SIZE + bit;
+        }
+    }
+    return -1;
+}
 
 int ga_semaphore_acquire(unsigned int initial_value)
 {
-    for (int i = 0; i < MAX_SEMAPHORES; i++) {
-        if (atomic_load_explicit(&ga_semaphores[i].used, memory_order_relaxed)) continue;
-        bool b = 0;
-        if (atomic_compare_exchange_strong(&ga_semaphores[i].used, &b, 1)) {
-            ga_semaphore_set(i, initial_value);
-            return i;
+    for (;;) {
+        unsigned int count = atomic_load_explicit(&gBlockCount, memory_order_acquire);
+        unsigned int hint = atomic_load_explicit(&gHint, memory_order_relaxed);
+        for (unsigned int i = 0; i < count; i++) {
+            unsigned int block = (hint + i) % count;
+            int id = claim(block);
+            if (id >= 0) {
+                if (block != hint) atomic_store_explicit(&gHint, block, memory_order_relaxed);
+                ga_semaphore *semaphore = ga_semaphore_ptr(id);
+                atomic_store_explicit(&semaphore->waiters, 0, memory_order_relaxed);
+                ga_semaphore_set(id, initial_value);
+                return id;
+            }
         }
+        if (!grow(count + 1)) fatal_error("No free semaphores (capacity %u)", atomic_load(&gMaxBlocks) * GA_SEMAPHORE_BLOCK_SIZE);
     }
-    fatal_error("No free semaphores");
-    // return 0; // avoid compiler warning
 }
 
 void ga_semaphore_release(int id)
 {
-    atomic_store(&ga_semaphores[id].used, 0);
+    unsigned int block = id / GA_SEMAPHORE_BLOCK_SIZE;
+    atomic_fetch_and_explicit(&gUsed[block], ~(1ull << (id % GA_SEMAPHORE_BLOCK_SIZE)), memory_order_release);
+    atomic_store_explicit(&gHint, block, memory_order_relaxed);
 }
 
+void ga_semaphore_set_capacity(unsigned int capacity)
+{
+    unsigned int blocks = (capacity + GA_SEMAPHORE_BLOCK_SIZE - 1) / GA_SEMAPHORE_BLOCK_SIZE;
+    assert(blocks <= GA_SEMAPHORE_MAX_BLOCKS && "Semaphore capacity too large");
+    atomic_store(&gMaxBlocks, blocks);
+}
 
+void ga_semaphore_reserve(unsigned int count)
+{
+    unsigned int blocks = (count + GA_SEMAPHORE_BLOCK_SIZE - 1) / GA_SEMAPHORE_BLOCK_SIZE;
+    if (!grow(blocks)) fatal_error("Can't reserve %u semaphores, capacity is %u", count, atomic_load(&gMaxBlocks) * GA_SEMAPHORE_BLOCK_SIZE);
+}
 
+// -----------------------------------------------------------------------------
+
+// Wakes up to count waiters
+void ga_semaphore_wake(int id, unsigned int count)
+{
+    ga_futex_wake(&ga_semaphore_ptr(id)->status, count < INT_MAX ? (int)count : INT_MAX);
+}
+
+static bool wait(int id, unsigned long long timeout_ns)
+{
+    ga_semaphore *semaphore = ga_semaphore_ptr(id);
+    for (int i = 0; i < SPIN_COUNT; i++) {
+        if (ga_semaphore_try_wait(id)) return true;
+        ga_cpu_relax();
+    }
+
+    unsigned long long deadline = ga_now_ns() + timeout_ns;
+    bool result = false;
+    atomic_fetch_add_explicit(&semaphore->waiters, 1, memory_order_seq_cst);
+    for (;;) {
+        if (ga_semaphore_try_wait(id)) {
+            result = true;
+            break;
+        }
+        unsigned long long now = ga_now_ns();
+        if (now >= deadline) break;
+        ga_futex_wait(&semaphore->status, 0, deadline - now);
+    }
+    atomic_fetch_sub_explicit(&semaphore->waiters, 1, memory_order_relaxed);
+    return result;
+}
+
+void ga_semaphore_wait(int id)
+{
+    wait(id, GA_FUTEX_FOREVER / 2);
+}
+
+bool ga_semaphore_timed_wait(int id, unsigned int ms)
+{
+    return wait(id, ms * 1000000ull);
+}
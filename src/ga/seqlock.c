@@ -0,0 +1,44 @@
+#include "ga/seqlock.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+
+ga_seqlock_array* ga_seqlock_array_create(size_t banks, size_t bank_size)
+{
+    return ga_seqlock_array_create_with_flags(banks, bank_size, GA_MEM_DEFAULT);
+}
+
+ga_seqlock_array* ga_seqlock_array_create_with_flags(size_t banks, size_t bank_size, ga_mem_flags flags)
+{
+    assert(banks > 0);
+    ga_seqlock_array *array = ga_newc(ga_seqlock_array);
+    array->banks = banks;
+    array->bank_size = bank_size;
+    // Banks on separate cache lines, so writes to one bank don't disturb readers of another
+    array->stride = (GA_SEQLOCK_BANK_HEADER + bank_size + CACHELINE_SIZE - 1) & ~(size_t)(CACHELINE_SIZE - 1);
+    if (flags) {
+        array->data = ga_calloc_realtime(banks, array->stride, flags, GA_ALLOC_TAG_DEFAULT);
+    } else {
+        array->data = ga_calloc_aligned(CACHELINE_SIZE, banks, array->stride);
+    }
+    return array;
+}
+
+void ga_seqlock_array_destroy(ga_seqlock_array *array)
+{
+    ga_free(array->data);
+    ga_free(array);
+}
+
+size_t ga_seqlock_array_banks(ga_seqlock_array *array)
+{
+    return array->banks;
+}
+
+size_t ga_seqlock_array_bank_size(ga_seqlock_array *array)
+{
+    return array->bank_size;
+}
@@ -0,0 +1,352 @@
+#include "ga/stream.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <string.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/lock.h"
+#include "ga/log.h"
+#include "ga/thread.h"
+#include "ga/ring_buffer.h"
+
+#define SEEK_FRAME_BITS     48
+#define SEEK_FRAME_MASK     ((1ull << SEEK_FRAME_BITS) - 1)
+#define GENERATION_MASK     0xffff
+
+struct ga_stream_file {
+    ga_stream_source        *source;
+    const ga_stream_decoder *decoder;
+    void                    *state;             //  Of the decoder
+    ga_stream_format        format;
+    float                   *head;              //  The first head_frames frames
+    size_t                  head_frames;
+    atomic_uint             voices;
+};
+
+// Precedes the frames of each chunk in a voice's ring buffer
+typedef struct chunk_header {
+    uint32_t    generation;                     //  Of the seek the chunk was read for
+    uint32_t    frames;
+    uint64_t    start;
+} chunk_header;
+
+struct ga_stream_voice {
+    ga_streamer         *streamer;
+    ga_stream_file      *file;
+    size_t              frame_size;
+    ga_ring_buffer      *ring;
+    ga_stream_voice     *next;
+
+    // Audio thread
+    atomic_ullong       position;
+    unsigned int        generation;
+    size_t              chunk_frames;           //  Left to read of the current chunk
+    unsigned int        chunk_generation;
+    uint64_t            chunk_position;
+    atomic_ullong       underruns;
+
+    // Seek requests, generation << SEEK_FRAME_BITS | frame
+    atomic_ullong       seek;
+
+    // Prefetch thread
+    unsigned int        fetch_generation;
+    uint64_t            fetch_position;
+    void                *chunk;                 //  Header and decoded frames
+};
+
+struct ga_streamer {
+    size_t              read_ahead;
+    unsigned int        interval;
+    ga_mutex            *lock;                  //  Held during a prefetch pass, and to add or remove voices
+    ga_stream_voice     *voices;
+    ga_thread           *thread;
+    atomic_uint         running;
+};
+
+static const ga_stream_decoder *gDecoders[GA_STREAM_MAX_DECODERS] = { &ga_stream_wav_decoder };
+static unsigned int gDecoderCount = 1;
+
+// -----------------------------------------------------------------------------
+
+// Decoders are registered at startup, before files are opened
+void ga_stream_register_decoder(const ga_stream_decoder *decoder)
+{
+    if (gDecoderCount == GA_STREAM_MAX_DECODERS) fatal_error("Too many stream decoders");
+    gDecoders[gDecoderCount++] = decoder;
+}
+
+static ga_stream_file* create_file(ga_stream_source *source, const ga_stream_decoder *decoder, void *state,
+                                   const ga_stream_format *format, size_t head_frames)
+{
+    ga_stream_file *file = ga_newc(ga_stream_file);
+    file->source = source;
+    file->decoder = decoder;
+    file->state = state;
+    file->format = *format;
+
+    // Decode the head cache, in memory that won't page fault in the audio thread
+    if (head_frames > format->frames) head_frames = format->frames;
+    if (head_frames) {
+        file->head = ga_malloc_realtime(head_frames * format->channels * sizeof(float), GA_MEM_REALTIME, GA_ALLOC_TAG_DEFAULT);
+        file->head_frames = decoder->read(state, 0, file->head, head_frames);
+    }
+    return file;
+}
+
+ga_stream_file* ga_stream_file_open(const char *path, size_t head_frames, ga_stream_flags flags)
+{
+    ga_stream_source *source = ga_stream_source_open(path, flags);
+    if (!source) return NULL;
+
+    unsigned char header[GA_STREAM_PROBE_SIZE];
+    size_t size = ga_stream_source_read(source, 0, sizeof(header), header);
+    for (unsigned int i = 0; i < gDecoderCount; i++) {
+        const ga_stream_decoder *decoder = gDecoders[i];
+        if (!decoder->probe(header, size)) continue;
+        ga_stream_format format;
+        void *state = decoder->open(source, &format);
+        if (!state) break;
+        return create_file(source, decoder, state, &format, head_frames);
+    }
+    ga_log_warning("Could not decode '%s'", path);
+    ga_stream_source_close(source);
+    return NULL;
+}
+
+ga_stream_file* ga_stream_file_open_raw(const char *path, size_t head_frames, ga_stream_flags flags,
+                                        unsigned int channels, double sample_rate, ga_sample_format format, uint64_t offset)
+{
+    assert(channels > 0);
+    ga_stream_source *source = ga_stream_source_open(path, flags);
+    if (!source) return NULL;
+    ga_stream_format stream_format;
+    void *state = ga_stream_raw_open(source, channels, sample_rate, format, offset, &stream_format);
+    return create_file(source, ga_stream_raw_decoder(), state, &stream_format, head_frames);
+}
+
+void ga_stream_file_close(ga_stream_file *file)
+{
+    assert(!atomic_load(&file->voices) && "File still has voices");
+    file->decoder->close(file->state);
+    ga_stream_source_close(file->source);
+    if (file->head) ga_free(file->head);
+    ga_free(file);
+}
+
+void ga_stream_file_get_format(ga_stream_file *file, ga_stream_format *format)
+{
+    *format = file->format;
+}
+
+// -----------------------------------------------------------------------------
+
+// Decodes chunks into the voice's ring buffer until it is full, returns false if there was nothing to do
+static bool prefetch(ga_stream_voice *voice)
+{
+    ga_stream_file *file = voice->file;
+    bool busy = false;
+
+    for (;;) {
+        uint64_t seek = atomic_load_explicit(&voice->seek, memory_order_acquire);
+        unsigned int generation = seek >> SEEK_FRAME_BITS;
+        if (generation != voice->fetch_generation) {
+            // Frames in the head cache are played from there
+            uint64_t frame = seek & SEEK_FRAME_MASK;
+            voice->fetch_generation = generation;
+            voice->fetch_position = frame > file->head_frames ? frame : file->head_frames;
+        }
+        if (voice->fetch_position >= file->format.frames) break;
+
+        uint64_t left = file->format.frames - voice->fetch_position;
+        size_t frames = left < GA_STREAM_CHUNK_FRAMES ? left : GA_STREAM_CHUNK_FRAMES;
+        if (ga_ring_buffer_can_write(voice->ring) < sizeof(chunk_header) + frames * voice->frame_size) break;
+
+        frames = file->decoder->read(file->state, voice->fetch_position, voice->chunk + sizeof(chunk_header), frames);
+        if (!frames) {
+            ga_log_warning("Stream decoder '%s' failed at frame %llu", file->decoder->name, (unsigned long long)voice->fetch_position);
+            voice->fetch_position = file->format.frames;
+            break;
+        }
+        chunk_header *header = voice->chunk;
+        header->generation = generation;
+        header->frames = frames;
+        header->start = voice->fetch_position;
+        ga_ring_buffer_write_atomic(voice->ring, sizeof(chunk_header) + frames * voice->frame_size, voice->chunk);
+        voice->fetch_position += frames;
+        busy = true;
+    }
+    return busy;
+}
+
+static void* prefetch_thread(void *data)
+{
+    ga_streamer *streamer = data;
+    while (atomic_load_explicit(&streamer->running, memory_order_acquire)) {
+        bool busy = false;
+        ga_mutex_lock(streamer->lock);
+        for (ga_stream_voice *voice = streamer->voices; voice; voice = voice->next) {
+            busy |= prefetch(voice);
+        }
+        ga_mutex_unlock(streamer->lock);
+        if (!busy) ga_thread_sleep(streamer->interval);
+    }
+    return NULL;
+}
+
+ga_streamer* ga_streamer_create(size_t read_ahead_frames, unsigned int interval_ms)
+{
+    assert(read_ahead_frames >= GA_STREAM_CHUNK_FRAMES);
+    ga_streamer *streamer = ga_newc(ga_streamer);
+    streamer->read_ahead = read_ahead_frames;
+    streamer->interval = interval_ms ? interval_ms : 1;
+    streamer->lock = ga_mutex_create(false);
+    atomic_init(&streamer->running, 1);
+    streamer->thread = ga_thread_create_named(prefetch_thread, streamer, "stream");
+    return streamer;
+}
+
+void ga_streamer_destroy(ga_streamer *streamer)
+{
+    assert(!streamer->voices && "Streamer still has voices");
+    atomic_store(&streamer->running, 0);
+    ga_thread_join(streamer->thread);
+    ga_mutex_destroy(streamer->lock);
+    ga_free(streamer);
+}
+
+// -----------------------------------------------------------------------------
+
+ga_stream_voice* ga_stream_voice_create(ga_streamer *streamer, ga_stream_file *file)
+{
+    ga_stream_voice *voice = ga_newc(ga_stream_voice);
+    voice->streamer = streamer;
+    voice->file = file;
+    voice->frame_size = file->format.channels * sizeof(float);
+
+    // Room for the read ahead, and the header of every chunk in it
+    size_t chunks = (streamer->read_ahead + GA_STREAM_CHUNK_FRAMES - 1) / GA_STREAM_CHUNK_FRAMES + 1;
+    voice->ring = ga_ring_buffer_create_with_flags(streamer->read_ahead * voice->frame_size + chunks * sizeof(chunk_header), GA_MEM_REALTIME);
+    voice->chunk = ga_malloc(sizeof(chunk_header) + GA_STREAM_CHUNK_FRAMES * voice->frame_size);
+    // Makes the prefetch thread pick up the initial position
+    voice->fetch_generation = -1;
+
+    atomic_fetch_add(&file->voices, 1);
+    ga_mutex_lock(streamer->lock);
+    voice->next = streamer->voices;
+    streamer->voices = voice;
+    ga_mutex_unlock(streamer->lock);
+    return voice;
+}
+
+void ga_stream_voice_destroy(ga_stream_voice *voice)
+{
+    ga_streamer *streamer = voice->streamer;
+    ga_mutex_lock(streamer->lock);
+    for (ga_stream_voice **v = &streamer->voices; *v; v = &(*v)->next) {
+        if (*v == voice) {
+            *v = voice->next;
+            break;
+        }
+    }
+    ga_mutex_unlock(streamer->lock);
+    atomic_fetch_sub(&voice->file->voices, 1);
+
+    ga_ring_buffer_destroy(voice->ring);
+    ga_free(voice->chunk);
+    ga_free(voice);
+}
+
+// Skips chunks read before the last seek, returns false if no current chunk is available
+static bool next_chunk(ga_stream_voice *voice)
+{
+    for (;;) {
+        if (voice->chunk_frames) {
+            if (voice->chunk_generation == voice->generation) return true;
+            ga_ring_buffer_skip(voice->ring, voice->chunk_frames * voice->frame_size);
+            voice->chunk_frames = 0;
+        }
+        // Chunks are written whole, so the frames follow the header. An empty
+        // ring is normal here, and must not be reported as an underflow.
+        if (ga_ring_buffer_can_read(voice->ring) < sizeof(chunk_header)) return false;
+        chunk_header header;
+        ga_ring_buffer_read_atomic(voice->ring, sizeof(chunk_header), &header);
+        voice->chunk_frames = header.frames;
+        voice->chunk_generation = header.generation;
+        voice->chunk_position = header.start;
+    }
+}
+
+// Reads the next frames, from the audio thread
+size_t ga_stream_voice_read(ga_stream_voice *voice, float *output, size_t frames)
+{
+    ga_stream_file *file = voice->file;
+    unsigned int channels = file->format.channels;
+    uint64_t position = atomic_load_explicit(&voice->position, memory_order_relaxed);
+    size_t done = 0;
+
+    // Make room for the prefetch thread after a seek, even while playing from the head cache
+    next_chunk(voice);
+
+    while (done < frames && position < file->format.frames) {
+        size_t wanted = frames - done;
+
+        if (position < file->head_frames) {
+            size_t count = file->head_frames - position < wanted ? file->head_frames - position : wanted;
+            memcpy(output + done * channels, file->head + position * channels, count * voice->frame_size);
+            position += count;
+            done += count;
+            continue;
+        }
+
+        if (!next_chunk(voice)) break;
+        if (voice->chunk_position != position) {
+            // Can't happen within a generation, but never play the wrong frames
+            ga_ring_buffer_skip(voice->ring, voice->chunk_frames * voice->frame_size);
+            voice->chunk_frames = 0;
+            continue;
+        }
+
+        size_t count = voice->chunk_frames < wanted ? voice->chunk_frames : wanted;
+        ga_ring_buffer_read(voice->ring, count * voice->frame_size, output + done * channels);
+        voice->chunk_frames -= count;
+        voice->chunk_position += count;
+        position += count;
+        done += count;
+    }
+
+    if (done < frames) {
+        memset(output + done * channels, 0, (frames - done) * voice->frame_size);
+        if (position < file->format.frames) {
+            atomic_store_explicit(&voice->underruns, atomic_load_explicit(&voice->underruns, memory_order_relaxed) + 1, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&voice->position, position, memory_order_relaxed);
+    return done;
+}
+
+// Moves the play position, from the audio thread
+void ga_stream_voice_seek(ga_stream_voice *voice, uint64_t frame)
+{
+    if (frame > voice->file->format.frames) frame = voice->file->format.frames;
+    voice->generation = (voice->generation + 1) & GENERATION_MASK;
+    atomic_store_explicit(&voice->position, frame, memory_order_relaxed);
+    atomic_store_explicit(&voice->seek, ((uint64_t)voice->generation << SEEK_FRAME_BITS) | frame, memory_order_release);
+}
+
+uint64_t ga_stream_voice_position(ga_stream_voice *voice)
+{
+    return atomic_load_explicit(&voice->position, memory_order_relaxed);
+}
+
+bool ga_stream_voice_finished(ga_stream_voice *voice)
+{
+    return ga_stream_voice_position(voice) >= voice->file->format.frames;
+}
+
+uint64_t ga_stream_voice_underruns(ga_stream_voice *voice)
+{
+    return atomic_load_explicit(&voice->underruns, memory_order_relaxed);
+}
@@ -0,0 +1,195 @@
+#include "ga/stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/log.h"
+
+// Decoder for uncompressed little endian PCM: WAV files, and raw files
+
+#define WAVE_FORMAT_PCM         0x0001
+#define WAVE_FORMAT_IEEE_FLOAT  0x0003
+#define WAVE_FORMAT_EXTENSIBLE  0xfffe
+
+typedef struct pcm {
+    ga_stream_source    *source;
+    unsigned int        channels;
+    ga_sample_format    format;
+    unsigned int        sample_size;    //  Bytes per sample
+    uint64_t            offset;         //  Of the first frame
+    uint64_t            frames;
+    unsigned char       *buffer;        //  Raw bytes of GA_STREAM_CHUNK_FRAMES frames
+} pcm;
+
+static const unsigned int gSampleSizes[] = { 2, 3, 4, 4 };
+
+// -----------------------------------------------------------------------------
+
+static inline uint32_t read_u16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t read_u32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void convert(const unsigned char *input, float *output, size_t samples, ga_sample_format format)
+{
+    switch (format) {
+    case GA_SAMPLE_INT16:
+        for (size_t i = 0; i < samples; i++, input += 2) {
+            output[i] = (int16_t)read_u16(input) * (1.0f / 32768.0f);
+        }
+        break;
+    case GA_SAMPLE_INT24:
+        for (size_t i = 0; i < samples; i++, input += 3) {
+            int32_t value = (int32_t)((input[0] << 8) | (input[1] << 16) | ((uint32_t)input[2] << 24)) >> 8;
+            output[i] = value * (1.0f / 8388608.0f);
+        }
+        break;
+    case GA_SAMPLE_INT32:
+        for (size_t i = 0; i < samples; i++, input += 4) {
+            output[i] = (int32_t)read_u32(input) * (1.0f / 2147483648.0f);
+        }
+        break;
+    case GA_SAMPLE_FLOAT32:
+        for (size_t i = 0; i < samples; i++, input += 4) {
+            uint32_t bits = read_u32(input);
+            memcpy(&output[i], &bits, sizeof(float));
+        }
+        break;
+    }
+}
+
+static pcm* create(ga_stream_source *source, unsigned int channels, ga_sample_format format, uint64_t offset, uint64_t bytes)
+{
+    pcm *decoder = ga_newc(pcm);
+    decoder->source = source;
+    decoder->channels = channels;
+    decoder->format = format;
+    decoder->sample_size = gSampleSizes[format];
+    decoder->offset = offset;
+    // Ignore a truncated last frame, and data sizes past the end of the file
+    uint64_t size = ga_stream_source_size(source);
+    uint64_t available = offset < size ? size - offset : 0;
+    if (bytes > available) bytes = available;
+    decoder->frames = bytes / (channels * decoder->sample_size);
+    decoder->buffer = ga_malloc(GA_STREAM_CHUNK_FRAMES * channels * decoder->sample_size);
+    return decoder;
+}
+
+static size_t pcm_read(void *data, uint64_t frame, float *output, size_t frames)
+{
+    pcm *decoder = data;
+    if (frame >= decoder->frames) return 0;
+    if (frames > decoder->frames - frame) frames = decoder->frames - frame;
+
+    size_t frame_size = decoder->channels * decoder->sample_size, done = 0;
+    while (done < frames) {
+        size_t count = frames - done < GA_STREAM_CHUNK_FRAMES ? frames - done : GA_STREAM_CHUNK_FRAMES;
+        size_t bytes = ga_stream_source_read(decoder->source, decoder->offset + (frame + done) * frame_size, count * frame_size, decoder->buffer);
+        count = bytes / frame_size;
+        if (!count) break;
+        convert(decoder->buffer, output + done * decoder->channels, count * decoder->channels, decoder->format);
+        done += count;
+    }
+    return done;
+}
+
+static void pcm_close(void *data)
+{
+    pcm *decoder = data;
+    ga_free(decoder->buffer);
+    ga_free(decoder);
+}
+
+// -----------------------------------------------------------------------------
+
+static bool wav_probe(const void *header, size_t size)
+{
+    return size >= 12 && !memcmp(header, "RIFF", 4) && !memcmp(header + 8, "WAVE", 4);
+}
+
+static void* wav_open(ga_stream_source *source, ga_stream_format *stream_format)
+{
+    unsigned char chunk[40];
+    uint64_t offset = 12, size = ga_stream_source_size(source);
+    unsigned int tag = 0, channels = 0, bits = 0;
+    double sample_rate = 0.0;
+    bool have_format = false;
+
+    while (offset + 8 <= size) {
+        if (ga_stream_source_read(source, offset, 8, chunk) < 8) break;
+        uint64_t chunk_size = read_u32(chunk + 4);
+        if (!memcmp(chunk, "fmt ", 4)) {
+            size_t length = chunk_size < sizeof(chunk) ? chunk_size : sizeof(chunk);
+            if (length < 16 || ga_stream_source_read(source, offset + 8, length, chunk) < length) break;
+            tag = read_u16(chunk);
+            channels = read_u16(chunk + 2);
+            sample_rate = read_u32(chunk + 4);
+            bits = read_u16(chunk + 14);
+            // The sub format GUID starts with the format tag
+            if (tag == WAVE_FORMAT_EXTENSIBLE && length >= 26) tag = read_u16(chunk + 24);
+            have_format = true;
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (!have_format || !channels) break;
+            ga_sample_format format;
+            if (tag == WAVE_FORMAT_PCM && bits == 16) format = GA_SAMPLE_INT16;
+            else if (tag == WAVE_FORMAT_PCM && bits == 24) format = GA_SAMPLE_INT24;
+            else if (tag == WAVE_FORMAT_PCM && bits == 32) format = GA_SAMPLE_INT32;
+            else if (tag == WAVE_FORMAT_IEEE_FLOAT && bits == 32) format = GA_SAMPLE_FLOAT32;
+            else {
+                ga_log_warning("Unsupported WAV format %u with %u bits", tag, bits);
+                return NULL;
+            }
+            // Streamed files may leave the data size at its maximum
+            pcm *decoder = create(source, channels, format, offset + 8, chunk_size);
+            stream_format->channels = channels;
+            stream_format->sample_rate = sample_rate;
+            stream_format->frames = decoder->frames;
+            return decoder;
+        }
+        // Chunks are padded to an even size
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+    ga_log_warning("Invalid WAV file");
+    return NULL;
+}
+
+const ga_stream_decoder ga_stream_wav_decoder = {
+    "wav",
+    wav_probe,
+    wav_open,
+    pcm_read,
+    pcm_close
+};
+
+// -----------------------------------------------------------------------------
+
+static const ga_stream_decoder gRawDecoder = {
+    "raw",
+    NULL,
+    NULL,
+    pcm_read,
+    pcm_close
+};
+
+// Returns the decoder state for gRawDecoder, see ga_stream_raw_decoder
+void* ga_stream_raw_open(ga_stream_source *source, unsigned int channels, double sample_rate,
+                         ga_sample_format format, uint64_t offset, ga_stream_format *stream_format)
+{
+    pcm *decoder = create(source, channels, format, offset, UINT64_MAX);
+    stream_format->channels = channels;
+    stream_format->sample_rate = sample_rate;
+    stream_format->frames = decoder->frames;
+    return decoder;
+}
+
+const ga_stream_decoder* ga_stream_raw_decoder()
+{
+    return &gRawDecoder;
+}
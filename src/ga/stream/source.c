@@ -0,0 +1,134 @@
+#include "ga/stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/log.h"
+
+#define IO_ALIGNMENT    4096                //  pread offsets and buffers are aligned to this
+#define IO_CHUNK        (1024 * 1024)       //  Bytes per pread
+#define ADVISE_AHEAD    (4 * 1024 * 1024)   //  Bytes hinted ahead of the read position
+
+struct ga_stream_source {
+    int         fd;
+    uint64_t    size;
+    void        *map;               //  The whole file, or NULL when using pread
+    char        *buffer;            //  Last pread chunk
+    uint64_t    buffer_offset;
+    size_t      buffer_size;
+    uint64_t    advised_start;      //  Range last hinted with madvise/posix_fadvise
+    uint64_t    advised_end;
+};
+
+// -----------------------------------------------------------------------------
+
+ga_stream_source* ga_stream_source_open(const char *path, ga_stream_flags flags)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ga_log_warning("Could not open '%s': %s", path, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ga_log_warning("Could not stat '%s': %s", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    ga_stream_source *source = ga_newc(ga_stream_source);
+    source->fd = fd;
+    source->size = st.st_size;
+
+    if (!(flags & GA_STREAM_PREAD) && source->size > 0 && source->size <= SIZE_MAX) {
+        void *map = mmap(NULL, source->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            source->map = map;
+            madvise(map, source->size, MADV_SEQUENTIAL);
+        } else {
+            ga_log_warning("Could not map '%s', using pread: %s", path, strerror(errno));
+        }
+    }
+    if (!source->map) {
+        source->buffer = ga_malloc_aligned(IO_ALIGNMENT, IO_CHUNK);
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+    return source;
+}
+
+void ga_stream_source_close(ga_stream_source *source)
+{
+    if (source->map) munmap(source->map, source->size);
+    if (source->buffer) ga_free(source->buffer);
+    close(source->fd);
+    ga_free(source);
+}
+
+uint64_t ga_stream_source_size(ga_stream_source *source)
+{
+    return source->size;
+}
+
+// Asks the kernel to start reading the range after offset, unless it already has
+static void advise(ga_stream_source *source, uint64_t offset)
+{
+    if (offset >= source->advised_start && offset + ADVISE_AHEAD / 2 <= source->advised_end) return;
+    uint64_t start = offset & ~(uint64_t)(IO_ALIGNMENT - 1);
+    if (start >= source->size) return;
+    uint64_t length = source->size - start < ADVISE_AHEAD ? source->size - start : ADVISE_AHEAD;
+    if (source->map) {
+        madvise(source->map + start, length, MADV_WILLNEED);
+    } else {
+#ifdef POSIX_FADV_WILLNEED
+        posix_fadvise(source->fd, start, length, POSIX_FADV_WILLNEED);
+#endif
+    }
+    source->advised_start = start;
+    source->advised_end = start + length;
+}
+
+// Reads up to size bytes at offset, returns the number of bytes read
+size_t ga_stream_source_read(ga_stream_source *source, uint64_t offset, size_t size, void *data)
+{
+    if (offset >= source->size) return 0;
+    if (size > source->size - offset) size = source->size - offset;
+    advise(source, offset + size);
+
+    if (source->map) {
+        memcpy(data, source->map + offset, size);
+        return size;
+    }
+
+    size_t done = 0;
+    while (done < size) {
+        uint64_t position = offset + done;
+        if (position < source->buffer_offset || position >= source->buffer_offset + source->buffer_size) {
+            uint64_t aligned = position & ~(uint64_t)(IO_ALIGNMENT - 1);
+            ssize_t result;
+            do {
+                result = pread(source->fd, source->buffer, IO_CHUNK, aligned);
+            } while (result < 0 && errno == EINTR);
+            if (result <= 0) {
+                source->buffer_size = 0;
+                break;
+            }
+            source->buffer_offset = aligned;
+            source->buffer_size = result;
+            if (position >= aligned + result) break;
+        }
+        size_t available = source->buffer_offset + source->buffer_size - position;
+        size_t count = size - done < available ? size - done : available;
+        memcpy(data + done, source->buffer + (position - source->buffer_offset), count);
+        done += count;
+    }
+    return done;
+}
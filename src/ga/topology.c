@@ -0,0 +1,279 @@
+#include "ga/topology.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/thread.h"
+#include "config.h"
+
+#ifndef SYSFS_CPU
+#define SYSFS_CPU "/sys/devices/system/cpu"
+#endif
+
+struct ga_topology {
+    ga_cpu_info     *cpus;
+    int             cpu_count;
+    int             core_count;
+    int             package_count;
+    int             llc_count;
+};
+
+// -----------------------------------------------------------------------------
+
+static bool read_line(const char *path, char *buffer, size_t size)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+    bool ok = fgets(buffer, size, file) != NULL;
+    fclose(file);
+    if (ok) buffer[strcspn(buffer, "\n")] = 0;
+    return ok;
+}
+
+static int read_int(const char *path, int fallback)
+{
+    char buffer[32];
+    return read_line(path, buffer, sizeof(buffer)) ? atoi(buffer) : fallback;
+}
+
+// Parses a CPU list like "0-3,8,10-11" into a cpu set
+static bool read_cpu_list(const char *path, ga_cpu_set *set)
+{
+    char buffer[4096];
+    ga_cpu_set_clear(set);
+    if (!read_line(path, buffer, sizeof(buffer))) return false;
+
+    char *p = buffer;
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p) break;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < GA_MAX_CPUS; cpu++) {
+            ga_cpu_set_add(set, cpu);
+        }
+        if (*p == ',') p++;
+    }
+    return true;
+}
+
+static int first_cpu(const ga_cpu_set *set)
+{
+    for (int cpu = 0; cpu < GA_MAX_CPUS; cpu++) {
+        if (ga_cpu_set_has(set, cpu)) return cpu;
+    }
+    return -1;
+}
+
+// Lowest CPU sharing the last level cache with `cpu`, used as the cache id
+static int llc_leader(int cpu)
+{
+    char path[256];
+    int leader = cpu, best_level = 0;
+
+    for (int index = 0; ; index++) {
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/level", cpu, index);
+        int level = read_int(path, -1);
+        if (level < 0) break;
+
+        char type[32];
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/type", cpu, index);
+        if (!read_line(path, type, sizeof(type)) || !strcmp(type, "Instruction")) continue;
+
+        ga_cpu_set shared;
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+        if (level > best_level && read_cpu_list(path, &shared) && !ga_cpu_set_is_empty(&shared)) {
+            best_level = level;
+            leader = first_cpu(&shared);
+        }
+    }
+    return leader;
+}
+
+// Maps an id (a leader CPU or a package id) to a dense index
+static int dense_index(int *ids, int *count, int id)
+{
+    for (int i = 0; i < *count; i++) {
+        if (ids[i] == id) return i;
+    }
+    ids[*count] = id;
+    return (*count)++;
+}
+
+static void read_topology(ga_topology *topology)
+{
+    ga_cpu_set online;
+    if (!read_cpu_list(SYSFS_CPU "/online", &online) || ga_cpu_set_is_empty(&online)) {
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        ga_cpu_set_clear(&online);
+        for (long cpu = 0; cpu < (count > 0 ? count : 1) && cpu < GA_MAX_CPUS; cpu++) {
+            ga_cpu_set_add(&online, cpu);
+        }
+    }
+
+    int count = 0;
+    for (int cpu = 0; cpu < GA_MAX_CPUS; cpu++) {
+        if (ga_cpu_set_has(&online, cpu)) count++;
+    }
+    topology->cpus = ga_calloc(count, sizeof(ga_cpu_info));
+
+    int *cores = ga_malloc(count * sizeof(int));
+    int *packages = ga_malloc(count * sizeof(int));
+    int *llcs = ga_malloc(count * sizeof(int));
+    int *smt = ga_calloc(count, sizeof(int));
+
+    char path[256];
+    int n = 0;
+    for (int cpu = 0; cpu < GA_MAX_CPUS; cpu++) {
+        if (!ga_cpu_set_has(&online, cpu)) continue;
+        ga_cpu_info *info = &topology->cpus[n++];
+        info->cpu = cpu;
+
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/physical_package_id", cpu);
+        info->package = dense_index(packages, &topology->package_count, read_int(path, 0));
+
+        ga_cpu_set siblings;
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/thread_siblings_list", cpu);
+        int core_leader = read_cpu_list(path, &siblings) && !ga_cpu_set_is_empty(&siblings) ? first_cpu(&siblings) : cpu;
+        info->core = dense_index(cores, &topology->core_count, core_leader);
+        info->smt_index = smt[info->core]++;
+
+        info->llc = dense_index(llcs, &topology->llc_count, llc_leader(cpu));
+    }
+    topology->cpu_count = n;
+
+    ga_free(cores);
+    ga_free(packages);
+    ga_free(llcs);
+    ga_free(smt);
+}
+
+// -----------------------------------------------------------------------------
+
+ga_topology* ga_topology_create()
+{
+    ga_topology *topology = ga_newc(ga_topology);
+    read_topology(topology);
+    return topology;
+}
+
+void ga_topology_destroy(ga_topology *topology)
+{
+    ga_free(topology->cpus);
+    ga_free(topology);
+}
+
+int ga_topology_cpu_count(ga_topology *topology)
+{
+    return topology->cpu_count;
+}
+
+int ga_topology_core_count(ga_topology *topology)
+{
+    return topology->core_count;
+}
+
+int ga_topology_package_count(ga_topology *topology)
+{
+    return topology->package_count;
+}
+
+int ga_topology_llc_count(ga_topology *topology)
+{
+    return topology->llc_count;
+}
+
+const ga_cpu_info* ga_topology_cpu(ga_topology *topology, int index)
+{
+    assert(index >= 0 && index < topology->cpu_count);
+    return &topology->cpus[index];
+}
+
+void ga_topology_core_cpus(ga_topology *topology, int core, ga_cpu_set *set)
+{
+    ga_cpu_set_clear(set);
+    for (int i = 0; i < topology->cpu_count; i++) {
+        if (topology->cpus[i].core == core) ga_cpu_set_add(set, topology->cpus[i].cpu);
+    }
+}
+
+void ga_topology_llc_cpus(ga_topology *topology, int llc, ga_cpu_set *set)
+{
+    ga_cpu_set_clear(set);
+    for (int i = 0; i < topology->cpu_count; i++) {
+        if (topology->cpus[i].llc == llc) ga_cpu_set_add(set, topology->cpus[i].cpu);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+int ga_topology_place(ga_topology *topology, ga_placement placement, unsigned int count, ga_cpu_set *sets)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        ga_cpu_set_clear(&sets[i]);
+    }
+    if (placement == GA_PLACEMENT_ANY || !count) return count;
+
+    // Candidates: the first logical CPU of every core, grouped by cache, core 0 last
+    ga_cpu_info **candidates = ga_malloc(topology->core_count * sizeof(ga_cpu_info*));
+    int candidate_count = 0;
+    for (int llc = 0; llc < topology->llc_count; llc++) {
+        for (int i = 0; i < topology->cpu_count; i++) {
+            ga_cpu_info *info = &topology->cpus[i];
+            if (info->smt_index == 0 && info->core != 0 && info->llc == llc) candidates[candidate_count++] = info;
+        }
+    }
+    for (int i = 0; i < topology->cpu_count; i++) {
+        ga_cpu_info *info = &topology->cpus[i];
+        if (info->smt_index == 0 && info->core == 0) candidates[candidate_count++] = info;
+    }
+
+    if (placement == GA_PLACEMENT_CORES_SAME_LLC && topology->llc_count > 1) {
+        // Keep the cores of the cache with the most cores
+        int *cores_per_llc = ga_calloc(topology->llc_count, sizeof(int));
+        for (int i = 0; i < candidate_count; i++) cores_per_llc[candidates[i]->llc]++;
+        int llc = 0;
+        for (int i = 1; i < topology->llc_count; i++) {
+            if (cores_per_llc[i] > cores_per_llc[llc]) llc = i;
+        }
+        int kept = 0;
+        for (int i = 0; i < candidate_count; i++) {
+            if (candidates[i]->llc == llc) candidates[kept++] = candidates[i];
+        }
+        candidate_count = kept;
+        ga_free(cores_per_llc);
+    }
+
+    // Use core 0 only when it's needed
+    int distinct = candidate_count;
+    if (candidate_count > 1 && count < candidate_count && candidates[candidate_count - 1]->core == 0) {
+        candidate_count--;
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        ga_cpu_set_add(&sets[i], candidates[i % candidate_count]->cpu);
+    }
+    ga_free(candidates);
+    return count < distinct ? count : distinct;
+}
+
+void ga_topology_print(ga_topology *topology)
+{
+    printf("%d cpus, %d cores, %d packages, %d last level caches\n",
+        topology->cpu_count, topology->core_count, topology->package_count, topology->llc_count);
+    for (int i = 0; i < topology->cpu_count; i++) {
+        ga_cpu_info *info = &topology->cpus[i];
+        printf("  cpu %3d: package %d, core %3d (smt %d), llc %d\n",
+            info->cpu, info->package, info->core, info->smt_index, info->llc);
+    }
+}
@@ -0,0 +1,249 @@
+#include "ga/trace.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+#include "ga/thread.h"
+#include "ga/ring_buffer.h"
+#include "ga/util/time.h"
+#include "config.h"
+
+#define DRAIN_BATCH 256
+
+atomic_uint ga_trace_enabled;
+_Thread_local ga_trace_buffer *ga_trace_local;
+
+static _Atomic(ga_trace_buffer*) gBuffers;      //  All buffers, never unlinked (reused after thread exit)
+static atomic_uint gNextId;
+static pthread_key_t gExitKey;
+static pthread_once_t gExitKeyOnce = PTHREAD_ONCE_INIT;
+
+// Collector state
+static ga_thread *gCollector;
+static atomic_uint gRunning;
+static unsigned int gInterval;
+static FILE *gFile;
+static bool gFirstEvent;
+static int gPid;
+static uint64_t gTicks0;
+static double gNsPerTick;
+static uint64_t gDroppedAtStart;
+
+// -----------------------------------------------------------------------------
+
+// Called when a thread with a buffer exits
+static void release_buffer(void *data)
+{
+    ga_trace_buffer *buffer = data;
+    atomic_store_explicit(&buffer->used, 0, memory_order_release);
+}
+
+static void create_exit_key()
+{
+    pthread_key_create(&gExitKey, release_buffer);
+}
+
+static ga_trace_buffer* acquire_buffer()
+{
+    // Reuse the buffer of an exited thread, once the collector has emptied it
+    for (ga_trace_buffer *buffer = atomic_load_explicit(&gBuffers, memory_order_acquire); buffer; buffer = buffer->next) {
+        unsigned int expected = 0;
+        if (!atomic_load_explicit(&buffer->used, memory_order_relaxed)
+                && !ga_ring_buffer_can_read(buffer->ring)
+                && atomic_compare_exchange_strong(&buffer->used, &expected, 1)) {
+            return buffer;
+        }
+    }
+
+    ga_trace_buffer *buffer = ga_newc_aligned(ga_trace_buffer);
+    buffer->ring = ga_ring_buffer_create_with_flags(GA_TRACE_BUFFER_EVENTS * sizeof(ga_trace_event), GA_MEM_REALTIME);
+    buffer->id = atomic_fetch_add(&gNextId, 1) + 1;
+    atomic_init(&buffer->used, 1);
+
+    ga_trace_buffer *head = atomic_load_explicit(&gBuffers, memory_order_relaxed);
+    do {
+        buffer->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&gBuffers, &head, buffer, memory_order_release, memory_order_relaxed));
+    return buffer;
+}
+
+ga_trace_buffer* ga_trace_local_buffer()
+{
+    if (!ga_trace_local) {
+        pthread_once(&gExitKeyOnce, create_exit_key);
+        ga_trace_buffer *buffer = acquire_buffer();
+        atomic_store_explicit(&buffer->name, NULL, memory_order_relaxed);
+        atomic_fetch_add_explicit(&buffer->generation, 1, memory_order_release);
+        pthread_setspecific(gExitKey, buffer);
+        ga_trace_local = buffer;
+    }
+    return ga_trace_local;
+}
+
+void ga_trace_register_thread(const char *name)
+{
+    ga_trace_buffer *buffer = ga_trace_local_buffer();
+    atomic_store_explicit(&buffer->name, name, memory_order_relaxed);
+    atomic_fetch_add_explicit(&buffer->generation, 1, memory_order_release);
+}
+
+// -----------------------------------------------------------------------------
+
+static void write_string(const char *string)
+{
+    fputc('"', gFile);
+    for (const char *c = string; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', gFile);
+        if ((unsigned char)*c >= 0x20) fputc(*c, gFile);
+    }
+    fputc('"', gFile);
+}
+
+static void begin_event()
+{
+    fputs(gFirstEvent ? "\n" : ",\n", gFile);
+    gFirstEvent = false;
+}
+
+static void write_thread_name(ga_trace_buffer *buffer, const char *name)
+{
+    char fallback[32];
+    if (!name) {
+        snprintf(fallback, sizeof(fallback), "thread %u", buffer->id);
+        name = fallback;
+    }
+    begin_event();
+    fprintf(gFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", gPid, buffer->id);
+    write_string(name);
+    fputs("}}", gFile);
+}
+
+static void write_event(ga_trace_buffer *buffer, const ga_trace_event *event)
+{
+    static const char *phases[] = { "B", "E", "i", "C" };
+    double us = ((int64_t)(event->time - gTicks0) * gNsPerTick) / 1000.0;
+
+    begin_event();
+    fputs("{\"name\":", gFile);
+    write_string(event->name);
+    fprintf(gFile, ",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u", phases[event->type], us, gPid, buffer->id);
+    switch (event->type) {
+    case GA_TRACE_EVENT_INSTANT:
+        fputs(",\"s\":\"t\"", gFile);
+        break;
+    case GA_TRACE_EVENT_COUNTER:
+        fprintf(gFile, ",\"args\":{\"value\":%lld}", (long long)event->value);
+        break;
+    }
+    fputc('}', gFile);
+}
+
+// Empties all buffers, writing the events if write is true
+static void drain(bool write)
+{
+    ga_trace_event events[DRAIN_BATCH];
+
+    for (ga_trace_buffer *buffer = atomic_load_explicit(&gBuffers, memory_order_acquire); buffer; buffer = buffer->next) {
+        unsigned int generation = atomic_load_explicit(&buffer->generation, memory_order_acquire);
+        if (write && generation != buffer->named_generation) {
+            buffer->named_generation = generation;
+            write_thread_name(buffer, atomic_load_explicit(&buffer->name, memory_order_relaxed));
+        }
+
+        size_t count;
+        while ((count = ga_ring_buffer_can_read(buffer->ring) / sizeof(ga_trace_event))) {
+            if (count > DRAIN_BATCH) count = DRAIN_BATCH;
+            ga_ring_buffer_read_atomic(buffer->ring, count * sizeof(ga_trace_event), events);
+            if (!write) continue;
+            for (size_t i = 0; i < count; i++) {
+                write_event(buffer, &events[i]);
+            }
+        }
+    }
+    if (write) fflush(gFile);
+}
+
+static uint64_t total_dropped()
+{
+    uint64_t dropped = 0;
+    for (ga_trace_buffer *buffer = atomic_load_explicit(&gBuffers, memory_order_acquire); buffer; buffer = buffer->next) {
+        dropped += atomic_load_explicit(&buffer->dropped, memory_order_relaxed);
+    }
+    return dropped;
+}
+
+static void* collector_thread(void *data)
+{
+    while (atomic_load_explicit(&gRunning, memory_order_acquire)) {
+        ga_thread_sleep(gInterval);
+        drain(true);
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+bool ga_trace_start(const char *path, unsigned int interval_ms)
+{
+    assert(!gCollector && "Trace already running");
+
+    gFile = fopen(path, "w");
+    if (!gFile) return false;
+
+    // Discard anything recorded after the last session was stopped
+    drain(false);
+    for (ga_trace_buffer *buffer = atomic_load_explicit(&gBuffers, memory_order_acquire); buffer; buffer = buffer->next) {
+        buffer->named_generation = 0;
+    }
+
+    // Relate the event timestamps to nanoseconds
+    uint64_t ticks0 = ga_trace_now(), ns0 = ga_now_ns();
+    usleep(20000);
+    uint64_t ticks1 = ga_trace_now(), ns1 = ga_now_ns();
+    gNsPerTick = ticks1 > ticks0 ? (double)(ns1 - ns0) / (ticks1 - ticks0) : 1.0;
+    gTicks0 = ticks1;
+
+    gPid = getpid();
+    gInterval = interval_ms ? interval_ms : 1;
+    gFirstEvent = true;
+    gDroppedAtStart = total_dropped();
+    fputs("[", gFile);
+
+    atomic_store(&gRunning, 1);
+    atomic_store(&ga_trace_enabled, 1);
+
+    gCollector = ga_thread_create_named(collector_thread, NULL, "trace");
+    return true;
+}
+
+void ga_trace_stop()
+{
+    if (!gCollector) return;
+
+    atomic_store(&ga_trace_enabled, 0);
+    atomic_store(&gRunning, 0);
+    ga_thread_join(gCollector);
+    gCollector = NULL;
+
+    drain(true);
+    fputs("\n]\n", gFile);
+    fclose(gFile);
+    gFile = NULL;
+}
+
+bool ga_trace_is_running()
+{
+    return gCollector != NULL;
+}
+
+uint64_t ga_trace_dropped()
+{
+    return total_dropped() - gDroppedAtStart;
+}
@@ -0,0 +1,46 @@
+#include "ga/triple_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ga/util.h"
+#include "ga/alloc.h"
+
+ga_triple_buffer* ga_triple_buffer_create(size_t size)
+{
+    return ga_triple_buffer_create_with_flags(size, GA_MEM_DEFAULT);
+}
+
+ga_triple_buffer* ga_triple_buffer_create_with_flags(size_t size, ga_mem_flags flags)
+{
+    ga_triple_buffer *buffer = ga_newc_aligned(ga_triple_buffer);
+    buffer->size = size;
+    buffer->slot_size = (size + CACHELINE_SIZE - 1) & ~(size_t)(CACHELINE_SIZE - 1);
+    if (!buffer->slot_size) buffer->slot_size = CACHELINE_SIZE;
+    if (flags) {
+        buffer->data = ga_calloc_realtime(3, buffer->slot_size, flags, GA_ALLOC_TAG_QUEUE);
+    } else {
+        buffer->data = ga_calloc_aligned_tagged(CACHELINE_SIZE, 3, buffer->slot_size, GA_ALLOC_TAG_QUEUE);
+    }
+    buffer->front = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->back = 2;
+    return buffer;
+}
+
+void ga_triple_buffer_destroy(ga_triple_buffer *buffer)
+{
+    ga_free(buffer->data);
+    ga_free(buffer);
+}
+
+size_t ga_triple_buffer_size(ga_triple_buffer *buffer)
+{
+    return buffer->size;
+}
+
+void ga_triple_buffer_write(ga_triple_buffer *buffer, const void *data)
+{
+    memcpy(ga_triple_buffer_write_slot(buffer), data, buffer->size);
+    ga_triple_buffer_publish(buffer);
+}
@@ -24,7 +24,7 @@ char *ga_sprintf(const char *format, ...)
     char *p, *np;
     va_list ap;
 
-   if ((p = ga_malloc(size)) == NULL)
+   if ((p = ga_malloc_tagged(size, GA_ALLOC_TAG_STRING)) == NULL)
         return NULL;
 
     while (1) {
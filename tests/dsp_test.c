@@ -0,0 +1,264 @@
+/*
+    gaudiamus
+
+    DSP kernel equivalence test
+
+    Runs every kernel set the CPU supports against the scalar
+    reference, for every length from 0 to MAX_LENGTH and every
+    misalignment up to a whole AVX-512 vector. Buffers are larger
+    than needed, and the samples after the end are checked too, so
+    a kernel writing past n is caught.
+
+    Clearing, copying, adding, peaks and clipping must match
+    exactly, also for NaN and infinities. Ramps, panning, rms and
+    dot products may round differently (fused multiply-add, another
+    summation order), and are compared with a tolerance.
+
+    Usage: ga_dsp_test
+
+    Exits with a non-zero status if any comparison fails.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include <ga/dsp.h>
+#include <ga/alloc.h>
+
+#define MAX_LENGTH      100
+#define MAX_OFFSET      16          // Floats, one AVX-512 vector
+#define BUFFER_LENGTH   (MAX_LENGTH + MAX_OFFSET + 16)
+#define RAMP_ULPS       8           // Per term of a multiply-add
+#define SUM_TOLERANCE   1e-5        // Relative to the sum of absolute terms
+
+typedef struct buffers {
+    float   *a, *b, *c;             //  Inputs
+    float   *ref, *ref2;            //  Outputs of the scalar kernels
+    float   *out, *out2;            //  Outputs of the kernels under test
+} buffers;
+
+static unsigned int gFailures = 0;
+static unsigned int gChecks = 0;
+static unsigned int gSeed = 1;
+
+// -----------------------------------------------------------------------------
+
+static float random_sample()
+{
+    gSeed = gSeed * 1103515245 + 12345;
+    return (float)((gSeed >> 8) & 0xffff) / 32768.0f - 1.0f;
+}
+
+static void fill(float *buffer, size_t n)
+{
+    for (size_t i = 0; i < n; i++) buffer[i] = random_sample();
+}
+
+static bool same(float a, float b)
+{
+    // Bitwise, so that NaN matches NaN and -0 does not match 0
+    return !memcmp(&a, &b, sizeof(float));
+}
+
+static bool within(float a, float b, double tolerance)
+{
+    if (isnan(a) || isnan(b)) return isnan(a) && isnan(b);
+    return fabs((double)a - b) <= tolerance;
+}
+
+static void fail(ga_dsp_isa isa, const char *kernel, size_t n, size_t offset, size_t i, float expected, float actual)
+{
+    if (gFailures++ < 20) {
+        fprintf(stderr, "FAIL %s %s n=%zu offset=%zu [%zu]: expected %.9g, got %.9g\n",
+                ga_dsp_isa_name(isa), kernel, n, offset, i, expected, actual);
+    }
+}
+
+// Compares whole buffers, including the samples before and after the range a kernel may write
+static void check_exact(ga_dsp_isa isa, const char *kernel, size_t n, size_t offset, const float *ref, const float *out)
+{
+    gChecks++;
+    for (size_t i = 0; i < BUFFER_LENGTH; i++) {
+        if (!same(ref[i], out[i])) {
+            fail(isa, kernel, n, offset, i, ref[i], out[i]);
+            return;
+        }
+    }
+}
+
+// Outside [offset, offset + n), the buffers must still match exactly
+static void check_ramp(ga_dsp_isa isa, const char *kernel, size_t n, size_t offset, const float *ref, const float *out)
+{
+    gChecks++;
+    for (size_t i = 0; i < BUFFER_LENGTH; i++) {
+        bool inside = i >= offset && i < offset + n;
+        double tolerance = RAMP_ULPS * FLT_EPSILON * (fabsf(ref[i]) > 1.0f ? fabsf(ref[i]) : 1.0f);
+        if (inside ? !within(ref[i], out[i], tolerance) : !same(ref[i], out[i])) {
+            fail(isa, kernel, n, offset, i, ref[i], out[i]);
+            return;
+        }
+    }
+}
+
+static void check_value(ga_dsp_isa isa, const char *kernel, size_t n, size_t offset, float expected, float actual, double tolerance)
+{
+    gChecks++;
+    if (tolerance ? !within(expected, actual, tolerance) : !same(expected, actual)) {
+        fail(isa, kernel, n, offset, 0, expected, actual);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+typedef void (* kernel_run)(buffers *buf, size_t n, size_t offset);
+
+static void run_clear(buffers *buf, size_t n, size_t offset)   { ga_dsp_clear(buf->out + offset, n); }
+static void run_copy(buffers *buf, size_t n, size_t offset)    { ga_dsp_copy(buf->out + offset, buf->a + offset, n); }
+static void run_add(buffers *buf, size_t n, size_t offset)     { ga_dsp_add(buf->out + offset, buf->a + offset, n); }
+static void run_clip(buffers *buf, size_t n, size_t offset)    { ga_dsp_clip(buf->out + offset, n, 0.5f); }
+static void run_mix(buffers *buf, size_t n, size_t offset)     { ga_dsp_mix(buf->out + offset, buf->a + offset, n, 0.7f); }
+static void run_mix_ramp(buffers *buf, size_t n, size_t offset) { ga_dsp_mix_ramp(buf->out + offset, buf->a + offset, n, 0.1f, 0.9f); }
+static void run_gain_ramp(buffers *buf, size_t n, size_t offset) { ga_dsp_gain_ramp(buf->out + offset, n, 1.0f, 0.25f); }
+
+static void run_pan(buffers *buf, size_t n, size_t offset)
+{
+    float left_gain, right_gain;
+    ga_dsp_pan_gains(-0.3f, &left_gain, &right_gain);
+    ga_dsp_pan(buf->out + offset, buf->out2 + offset, buf->a + offset, n, left_gain, right_gain);
+}
+
+typedef struct buffer_kernel {
+    const char  *name;
+    kernel_run  run;
+    bool        exact;
+    bool        stereo;
+} buffer_kernel;
+
+static const buffer_kernel gBufferKernels[] = {
+    { "clear",      run_clear,      true,   false },
+    { "copy",       run_copy,       true,   false },
+    { "add",        run_add,        true,   false },
+    { "clip",       run_clip,       true,   false },
+    { "mix",        run_mix,        false,  false },
+    { "mix_ramp",   run_mix_ramp,   false,  false },
+    { "gain_ramp",  run_gain_ramp,  false,  false },
+    { "pan",        run_pan,        false,  true  },
+};
+
+#define BUFFER_KERNELS  (sizeof(gBufferKernels) / sizeof(gBufferKernels[0]))
+
+// Runs a kernel with the scalar and the tested set on the same input
+static void test_buffer_kernel(ga_dsp_isa isa, const buffer_kernel *kernel, buffers *buf, size_t n, size_t offset)
+{
+    ga_dsp_set_isa(GA_DSP_SCALAR);
+    memcpy(buf->ref, buf->b, BUFFER_LENGTH * sizeof(float));
+    memcpy(buf->out, buf->b, BUFFER_LENGTH * sizeof(float));
+    memcpy(buf->ref2, buf->c, BUFFER_LENGTH * sizeof(float));
+    memcpy(buf->out2, buf->c, BUFFER_LENGTH * sizeof(float));
+
+    // The scalar results go to ref/ref2 by swapping them in
+    float *out = buf->out, *out2 = buf->out2;
+    buf->out = buf->ref;
+    buf->out2 = buf->ref2;
+    kernel->run(buf, n, offset);
+    buf->out = out;
+    buf->out2 = out2;
+
+    ga_dsp_set_isa(isa);
+    kernel->run(buf, n, offset);
+
+    if (kernel->exact) {
+        check_exact(isa, kernel->name, n, offset, buf->ref, buf->out);
+    } else {
+        check_ramp(isa, kernel->name, n, offset, buf->ref, buf->out);
+        if (kernel->stereo) check_ramp(isa, kernel->name, n, offset, buf->ref2, buf->out2);
+    }
+}
+
+static void test_reductions(ga_dsp_isa isa, buffers *buf, size_t n, size_t offset)
+{
+    const float *a = buf->a + offset, *b = buf->b + offset;
+    double magnitude = 0.0, squares = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        magnitude += fabs((double)a[i] * b[i]);
+        squares += (double)a[i] * a[i];
+    }
+
+    ga_dsp_set_isa(GA_DSP_SCALAR);
+    float peak = ga_dsp_peak(a, n), rms = ga_dsp_rms(a, n), dot = ga_dsp_dot(a, b, n);
+
+    ga_dsp_set_isa(isa);
+    check_value(isa, "peak", n, offset, peak, ga_dsp_peak(a, n), 0.0);
+    check_value(isa, "rms", n, offset, rms, ga_dsp_rms(a, n), SUM_TOLERANCE * (n ? sqrt(squares / n) : 0.0) + FLT_MIN);
+    check_value(isa, "dot", n, offset, dot, ga_dsp_dot(a, b, n), SUM_TOLERANCE * magnitude + FLT_MIN);
+}
+
+// NaN and infinities in every lane position, and in the scalar tail
+static void test_special_values(ga_dsp_isa isa, buffers *buf)
+{
+    const float specials[] = { NAN, -NAN, INFINITY, -INFINITY, 0.5f, -0.5f, 0.0f, -0.0f };
+    const size_t count = sizeof(specials) / sizeof(specials[0]);
+
+    for (size_t n = 1; n <= MAX_LENGTH; n += 7) {
+        for (size_t position = 0; position < n; position++) {
+            for (size_t s = 0; s < count; s++) {
+                fill(buf->b, BUFFER_LENGTH);
+                buf->b[position] = specials[s];
+                memcpy(buf->a, buf->b, BUFFER_LENGTH * sizeof(float));
+
+                test_buffer_kernel(isa, &gBufferKernels[3], buf, n, 0);    // clip
+
+                ga_dsp_set_isa(GA_DSP_SCALAR);
+                float peak = ga_dsp_peak(buf->b, n);
+                ga_dsp_set_isa(isa);
+                check_value(isa, "peak (special)", n, position, peak, ga_dsp_peak(buf->b, n), 0.0);
+            }
+        }
+    }
+}
+
+static void test_isa(ga_dsp_isa isa, buffers *buf)
+{
+    unsigned int failures = gFailures;
+    for (size_t n = 0; n <= MAX_LENGTH; n++) {
+        for (size_t offset = 0; offset < MAX_OFFSET; offset++) {
+            fill(buf->a, BUFFER_LENGTH);
+            fill(buf->b, BUFFER_LENGTH);
+            fill(buf->c, BUFFER_LENGTH);
+            for (size_t k = 0; k < BUFFER_KERNELS; k++) {
+                test_buffer_kernel(isa, &gBufferKernels[k], buf, n, offset);
+            }
+            test_reductions(isa, buf, n, offset);
+        }
+    }
+    test_special_values(isa, buf);
+    printf("%-8s %s\n", ga_dsp_isa_name(isa), gFailures == failures ? "ok" : "FAILED");
+}
+
+// -----------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    buffers buf;
+    float **all[] = { &buf.a, &buf.b, &buf.c, &buf.ref, &buf.ref2, &buf.out, &buf.out2 };
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) *all[i] = ga_dsp_alloc(BUFFER_LENGTH);
+
+    ga_dsp_isa best = ga_dsp_best_isa();
+    for (ga_dsp_isa isa = GA_DSP_SCALAR; isa < GA_DSP_ISA_COUNT; isa++) {
+        if (!ga_dsp_set_isa(isa)) {
+            printf("%-8s not supported, skipped\n", ga_dsp_isa_name(isa));
+            continue;
+        }
+        test_isa(isa, &buf);
+    }
+    ga_dsp_set_isa(best);
+
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) ga_free(*all[i]);
+
+    printf("%u checks, %u failures\n", gChecks, gFailures);
+    return gFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}